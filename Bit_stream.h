@@ -4,16 +4,19 @@
 #ifndef __STDC_CONSTANT_MACROS
 #define __STDC_CONSTANT_MACROS
 #endif
+#include <cstring>
 #include <iostream>
 #include <limits>
+#include <vector>
 #include <stdint.h>
 
 #include "errors.h"
 #include "crc.h"
+#include "perf.h"
 
 // host-endian-neutral integer reading
 namespace {
-    uint32_t read_32_le(unsigned char b[4])
+    uint32_t read_32_le(const unsigned char b[4])
     {
         uint32_t v = 0;
         for (int i = 3; i >= 0; i--)
@@ -51,7 +54,7 @@ namespace {
         os.write(b, 4);
     }
 
-    uint16_t read_16_le(unsigned char b[2])
+    uint16_t read_16_le(const unsigned char b[2])
     {
         uint16_t v = 0;
         for (int i = 1; i >= 0; i--)
@@ -89,7 +92,7 @@ namespace {
         os.write(b, 2);
     }
 
-    uint32_t read_32_be(unsigned char b[4])
+    uint32_t read_32_be(const unsigned char b[4])
     {
         uint32_t v = 0;
         for (int i = 0; i < 4; i++)
@@ -127,7 +130,7 @@ namespace {
         os.write(b, 4);
     }
 
-    uint16_t read_16_be(unsigned char b[2])
+    uint16_t read_16_be(const unsigned char b[2])
     {
         uint16_t v = 0;
         for (int i = 0; i < 2; i++)
@@ -167,32 +170,73 @@ namespace {
 
 }
 
-// using an istream, pull off individual bits with get_bit (LSB first)
+// pull off bits LSB first, either from an istream or from a contiguous
+// buffer. The istream is read a byte at a time so it is never left past the
+// last bit used; a buffer is read a word at a time into a 64-bit accumulator.
 class Bit_stream {
-    std::istream& is;
+    std::istream* is;
+    const unsigned char* ptr;
+    const unsigned char* end;
 
-    unsigned char bit_buffer;
+    uint64_t bit_buffer;
     unsigned int bits_left;
     unsigned long total_bits_read;
 
+    // make at least n bits available, up to 32
+    void refill(unsigned int n) {
+        if (is) {
+            while (bits_left < n) {
+                int c = is->get();
+                if (c == EOF) throw Out_of_bits();
+                bit_buffer |= static_cast<uint64_t>(c & 0xFF) << bits_left;
+                bits_left += 8;
+            }
+            return;
+        }
+
+        if (end - ptr >= 8) {
+            // whole bytes that fit, at most 7 so the shift stays in range
+            unsigned int bytes = (63 - bits_left) >> 3;
+            uint64_t w;
+            memcpy(&w, ptr, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            w = __builtin_bswap64(w);
+#endif
+            bit_buffer |= (w & ((UINT64_C(1) << (bytes * 8)) - 1)) << bits_left;
+            ptr += bytes;
+            bits_left += bytes * 8;
+        } else {
+            while (bits_left <= 56 && ptr != end) {
+                bit_buffer |= static_cast<uint64_t>(*ptr++) << bits_left;
+                bits_left += 8;
+            }
+        }
+        if (bits_left < n) throw Out_of_bits();
+    }
+
 public:
     class Weird_char_size {};
     class Out_of_bits {};
 
-    Bit_stream(std::istream& _is) : is(_is), bit_buffer(0), bits_left(0), total_bits_read(0) {
+    Bit_stream(std::istream& _is) : is(&_is), ptr(nullptr), end(nullptr), bit_buffer(0), bits_left(0), total_bits_read(0) {
+    }
+    Bit_stream(const unsigned char* data, size_t size) : is(nullptr), ptr(data), end(data + size), bit_buffer(0), bits_left(0), total_bits_read(0) {
     }
-    bool get_bit() {
-        if (bits_left == 0) {
 
-            int c = is.get();
-            if (c == EOF) throw Out_of_bits();
-            bit_buffer = static_cast<unsigned char>(c);
-            bits_left = 8;
+    // next n bits (n <= 32), first bit read in the lowest position
+    unsigned int get_bits(unsigned int n) {
+        if (n == 0) return 0;
+        if (bits_left < n) refill(n);
 
-        }
-        total_bits_read++;
-        bits_left --;
-        return ( ( bit_buffer & ( 0x80 >> bits_left ) ) != 0);
+        unsigned int v = static_cast<unsigned int>(bit_buffer & ((UINT64_C(1) << n) - 1));
+        bit_buffer >>= n;
+        bits_left -= n;
+        total_bits_read += n;
+        return v;
+    }
+
+    bool get_bit() {
+        return get_bits(1) != 0;
     }
 
     unsigned long get_total_bits_read(void) const
@@ -201,17 +245,56 @@ public:
     }
 };
 
+// takes whole packets from a Bit_oggstream in place of Ogg pages
+class Ogg_packet_sink {
+public:
+    virtual ~Ogg_packet_sink() {}
+    virtual void packet(const unsigned char* data, unsigned int bytes, uint32_t granule, bool first, bool last) = 0;
+};
+
 class Bit_oggstream {
-    std::ostream& os;
+    std::ostream* os;
+    Ogg_packet_sink* sink;
 
     unsigned char bit_buffer;
     unsigned int bits_stored;
 
     enum {header_bytes = 27, max_segments = 255, segment_size = 255};
 
+    void put_byte(unsigned char b) {
+        if (payload_bytes == segment_size * max_segments)
+        {
+            page_full();
+        }
+
+        page_buffer[header_bytes + max_segments + payload_bytes] = b;
+        payload_bytes ++;
+    }
+
+    // a packet that doesn't fit in one page: a sink gets it whole once it
+    // ends, so what's built so far moves to sink_packet; an Ogg stream
+    // carries it on in a continued page
+    void page_full() {
+        if (sink)
+        {
+            const unsigned char* payload = &page_buffer[header_bytes + max_segments];
+            sink_packet.insert(sink_packet.end(), payload, payload + payload_bytes);
+            payload_bytes = 0;
+            return;
+        }
+
+        // no packet ends on this page, so it has no granule position
+        uint32_t packet_granule = granule;
+        granule = UINT32_C(0xFFFFFFFF);
+        write_page(true, false);
+        granule = packet_granule;
+    }
+
     unsigned int payload_bytes;
+    unsigned long total_bits_written;
     bool first, continued;
     unsigned char page_buffer[header_bytes + max_segments + segment_size * max_segments];
+    std::vector<unsigned char> sink_packet;
     uint32_t granule;
     uint32_t seqno;
 
@@ -219,7 +302,14 @@ public:
     class Weird_char_size {};
 
     Bit_oggstream(std::ostream& _os) :
-		os(_os), bit_buffer(0), bits_stored(0), payload_bytes(0), first(true), continued(false), page_buffer{}, granule(0),
+		os(&_os), sink(nullptr), bit_buffer(0), bits_stored(0), payload_bytes(0), total_bits_written(0), first(true), continued(false), page_buffer{}, granule(0),
+		seqno(0)
+	{
+	}
+
+    // every packet goes to the sink whole when its page is flushed, no pages are built
+    explicit Bit_oggstream(Ogg_packet_sink& _sink) :
+		os(nullptr), sink(&_sink), bit_buffer(0), bits_stored(0), payload_bytes(0), total_bits_written(0), first(true), continued(false), page_buffer{}, granule(0),
 		seqno(0)
 	{
 	}
@@ -229,24 +319,84 @@ public:
         bit_buffer |= 1<<bits_stored;
 
         bits_stored ++;
+        total_bits_written ++;
         if (bits_stored == 8) {
             flush_bits();
         }
     }
 
-    void set_granule(uint32_t g) {
-        granule = g;
+    // low n bits of value (n <= 32), lowest bit first
+    void put_bits(uint32_t value, unsigned int n) {
+        uint64_t acc = bit_buffer | ((value & ((UINT64_C(1) << n) - 1)) << bits_stored);
+        unsigned int total = bits_stored + n;
+
+        while (total >= 8) {
+            put_byte(static_cast<unsigned char>(acc));
+            acc >>= 8;
+            total -= 8;
+        }
+        bit_buffer = static_cast<unsigned char>(acc);
+        bits_stored = total;
+        total_bits_written += n;
     }
 
-    void flush_bits(void) {
+    // whole bytes; a straight copy into the page when byte-aligned
+    void put_bytes(const unsigned char* data, size_t n) {
         if (bits_stored != 0) {
-            if (payload_bytes == segment_size * max_segments)
+            // each output byte is the carried bits plus the low end of the next input byte
+            for (size_t i = 0; i < n; i++) {
+                put_byte(static_cast<unsigned char>(bit_buffer | (data[i] << bits_stored)));
+                bit_buffer = static_cast<unsigned char>(data[i] >> (8 - bits_stored));
+            }
+        } else {
+            while (n > segment_size * max_segments - payload_bytes)
             {
-                throw Parse_error_str("ran out of space in an Ogg packet");
+                size_t fits = segment_size * max_segments - payload_bytes;
+                memcpy(&page_buffer[header_bytes + max_segments + payload_bytes], data, fits);
+                payload_bytes += static_cast<unsigned int>(fits);
+                data += fits;
+                n -= fits;
+                total_bits_written += 8 * fits;
+                page_full();
             }
+            memcpy(&page_buffer[header_bytes + max_segments + payload_bytes], data, n);
+            payload_bytes += static_cast<unsigned int>(n);
+        }
+        total_bits_written += 8 * n;
+    }
+
+    // a bit string as written by an earlier Bit_oggstream, bit_count long
+    void copy_bits(const unsigned char* data, unsigned long bit_count) {
+        put_bytes(data, bit_count / 8);
+        if (bit_count % 8)
+            put_bits(data[bit_count / 8], bit_count % 8);
+    }
+
+    // payload of the packet being built, the last byte padded out; nullptr
+    // once it has outgrown a page and part of it is held elsewhere
+    const unsigned char* get_payload(unsigned int& bytes) {
+        flush_bits();
+        if (continued || !sink_packet.empty())
+        {
+            bytes = 0;
+            return nullptr;
+        }
+        bytes = payload_bytes;
+        return &page_buffer[header_bytes + max_segments];
+    }
+
+    unsigned long get_total_bits_written(void) const
+    {
+        return total_bits_written;
+    }
 
-            page_buffer[header_bytes + max_segments + payload_bytes] = bit_buffer;
-            payload_bytes ++;
+    void set_granule(uint32_t g) {
+        granule = g;
+    }
+
+    void flush_bits(void) {
+        if (bits_stored != 0) {
+            put_byte(bit_buffer);
 
             bits_stored = 0;
             bit_buffer = 0;
@@ -254,12 +404,42 @@ public:
     }
 
     void flush_page(bool next_continued=false, bool last=false) {
-        if (payload_bytes != segment_size * max_segments)
+        flush_bits();
+
+        if (sink)
         {
-            flush_bits();
+            if (payload_bytes != 0 || !sink_packet.empty())
+            {
+                const unsigned char* payload = &page_buffer[header_bytes + max_segments];
+                unsigned int bytes = payload_bytes;
+                if (!sink_packet.empty())
+                {
+                    sink_packet.insert(sink_packet.end(), payload, payload + payload_bytes);
+                    payload = sink_packet.data();
+                    bytes = static_cast<unsigned int>(sink_packet.size());
+                }
+                sink->packet(payload, bytes, granule, first, last);
+                sink_packet.clear();
+
+                seqno++;
+                first = false;
+                continued = next_continued;
+                payload_bytes = 0;
+            }
+            return;
         }
 
-        if (payload_bytes != 0)
+        // a packet that fills its page exactly ends with an empty segment on the next one
+        if (payload_bytes == segment_size * max_segments)
+        {
+            page_full();
+        }
+        write_page(next_continued, last);
+    }
+
+    // the page buffer as one Ogg page; a continued page goes out even when empty
+    void write_page(bool next_continued, bool last) {
+        if (payload_bytes != 0 || continued)
         {
             unsigned int segments = (payload_bytes+segment_size)/segment_size;  // intentionally round up
             if (segments == max_segments+1) segments = max_segments; // at max eschews the final 0
@@ -305,10 +485,8 @@ public:
                     );
 
             // output to ostream
-            for (unsigned int i = 0; i < header_bytes + segments + payload_bytes; i++)
-            {
-                os.put(page_buffer[i]);
-            }
+            os->write(reinterpret_cast<const char *>(page_buffer), header_bytes + segments + payload_bytes);
+            PERF_COUNT(Pages, 1);
 
             seqno++;
             first = false;
@@ -353,17 +531,12 @@ public:
     operator unsigned int() const { return total; }
 
     friend Bit_stream& operator >> (Bit_stream& bstream, Bit_uint& bui) {
-        bui.total = 0;
-        for ( unsigned int i = 0; i < BIT_SIZE; i++) {
-            if ( bstream.get_bit() ) bui.total |= (1U << i);
-        }
+        bui.total = bstream.get_bits(BIT_SIZE);
         return bstream;
     }
 
     friend Bit_oggstream& operator << (Bit_oggstream& bstream, const Bit_uint& bui) {
-        for ( unsigned int i = 0; i < BIT_SIZE; i++) {
-            bstream.put_bit((bui.total & (1U << i)) != 0);
-        }
+        bstream.put_bits(bui.total, BIT_SIZE);
         return bstream;
     }
 };
@@ -399,17 +572,12 @@ public:
     operator unsigned int() const { return total; }
 
     friend Bit_stream& operator >> (Bit_stream& bstream, Bit_uintv& bui) {
-        bui.total = 0;
-        for ( unsigned int i = 0; i < bui.size; i++) {
-            if ( bstream.get_bit() ) bui.total |= (1U << i);
-        }
+        bui.total = bstream.get_bits(bui.size);
         return bstream;
     }
 
     friend Bit_oggstream& operator << (Bit_oggstream& bstream, const Bit_uintv& bui) {
-        for ( unsigned int i = 0; i < bui.size; i++) {
-            bstream.put_bit((bui.total & (1U << i)) != 0);
-        }
+        bstream.put_bits(bui.total, bui.size);
         return bstream;
     }
 };
@@ -436,4 +604,70 @@ public:
     }
 };
 
+// appends everything written to a vector, so a converted file can be kept
+// in memory until it's written out
+class vector_streambuf : public std::streambuf
+{
+    vector_streambuf& operator=(const vector_streambuf& rhs) = delete;
+    vector_streambuf(const vector_streambuf &rhs) = delete;
+
+    std::vector<char>& out;
+
+public:
+    explicit vector_streambuf(std::vector<char>& v) : out(v) {}
+
+protected:
+    int_type overflow(int_type c) override
+    {
+        if (!traits_type::eq_int_type(c, traits_type::eof()))
+            out.push_back(traits_type::to_char_type(c));
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char * s, std::streamsize n) override
+    {
+        out.insert(out.end(), s, s + n);
+        return n;
+    }
+};
+
+// read-only view of a memory span, seekable so the RIFF parser can hop
+// between chunks without copying the span
+class span_streambuf : public std::streambuf
+{
+    span_streambuf& operator=(const span_streambuf& rhs) = delete;
+    span_streambuf(const span_streambuf &rhs) = delete;
+
+public:
+    span_streambuf(const char * a, long l)
+    {
+        char * p = const_cast<char *>(a);
+        setg(p, p, p+l);
+    }
+
+protected:
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override
+    {
+        if (!(which & std::ios_base::in)) return pos_type(off_type(-1));
+
+        off_type base;
+        if (dir == std::ios_base::beg)
+            base = 0;
+        else if (dir == std::ios_base::cur)
+            base = gptr() - eback();
+        else
+            base = egptr() - eback();
+
+        if (base + off < 0 || base + off > egptr() - eback()) return pos_type(off_type(-1));
+
+        setg(eback(), eback() + base + off, egptr());
+        return pos_type(base + off);
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override
+    {
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+};
+
 #endif // _BIT_STREAM_H
@@ -0,0 +1,402 @@
+/*
+soundextract
+Copyright 2018 Jonathan wilson
+Copyright 2020 Sławomir Śpiewak
+
+Soundextract is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version. See the file COPYING for more details.
+*/
+
+//Wwise ADPCM block layout conversion and decoding
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "adpcm.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define ADPCM_SSE2
+    #include <emmintrin.h>
+#endif
+#if defined(ADPCM_SSE2) && (defined(__GNUC__) || defined(__clang__))
+    #define ADPCM_AVX2
+    #include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+    #define ADPCM_NEON
+    #include <arm_neon.h>
+#endif
+
+//a block is a channels x words matrix of 32 bit words; out is its transpose
+static inline void TransposeWords(const uint8_t *in, uint8_t *out, unsigned int channels, size_t words, size_t first)
+{
+    for (size_t n = first; n < words; n++)
+    {
+        for (unsigned int s = 0; s < channels; s++)
+        {
+            memcpy(out + 4 * (n * channels + s), in + 4 * (s * words + n), 4);
+        }
+    }
+}
+
+void DeinterleaveAdpcmBlocksScalar(const uint8_t *in, uint8_t *out, size_t blocks, unsigned int channels, size_t blockAlign)
+{
+    size_t words = blockAlign / (channels * 4u);
+    for (size_t block = 0; block < blocks; block++)
+    {
+        const uint8_t *src = in + block * blockAlign;
+        uint8_t *dst = out + block * blockAlign;
+        for (size_t n = 0; n < words; n++)
+        {
+            for (unsigned int s = 0; s < channels; s++)
+            {
+                //channel s starts at word s * blockAlign / (channels * 4),
+                //which is s * words whenever the block splits evenly
+                memcpy(dst + 4 * (n * channels + s), src + 4 * (s * blockAlign / (channels * 4u) + n), 4);
+            }
+        }
+    }
+}
+
+#ifdef ADPCM_SSE2
+static inline __m128i Load(const uint8_t *p)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+}
+
+static inline void Store(uint8_t *p, __m128i v)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v);
+}
+
+//4 words of every channel per step
+static void DeinterleaveSse2(const uint8_t *in, uint8_t *out, size_t blocks, unsigned int channels, size_t blockAlign)
+{
+    size_t words = blockAlign / (channels * 4u);
+    size_t stride = 4 * words;
+    for (size_t block = 0; block < blocks; block++)
+    {
+        const uint8_t *src = in + block * blockAlign;
+        uint8_t *dst = out + block * blockAlign;
+        size_t n = 0;
+        for (; n + 4 <= words; n += 4)
+        {
+            const uint8_t *p = src + 4 * n;
+            uint8_t *q = dst + 4 * n * channels;
+            __m128i c0 = Load(p), c1 = Load(p + stride);
+            __m128i lo01 = _mm_unpacklo_epi32(c0, c1), hi01 = _mm_unpackhi_epi32(c0, c1);
+            if (channels == 2)
+            {
+                Store(q, lo01);
+                Store(q + 16, hi01);
+                continue;
+            }
+            __m128i c2 = Load(p + 2 * stride), c3 = Load(p + 3 * stride);
+            __m128i lo23 = _mm_unpacklo_epi32(c2, c3), hi23 = _mm_unpackhi_epi32(c2, c3);
+            __m128i r0 = _mm_unpacklo_epi64(lo01, lo23), r1 = _mm_unpackhi_epi64(lo01, lo23);
+            __m128i r2 = _mm_unpacklo_epi64(hi01, hi23), r3 = _mm_unpackhi_epi64(hi01, hi23);
+            if (channels == 4)
+            {
+                Store(q, r0);
+                Store(q + 16, r1);
+                Store(q + 32, r2);
+                Store(q + 48, r3);
+                continue;
+            }
+            //6 channels: rows are 4 words from the 4x4 transpose plus a pair
+            __m128i c4 = Load(p + 4 * stride), c5 = Load(p + 5 * stride);
+            __m128i lo45 = _mm_unpacklo_epi32(c4, c5), hi45 = _mm_unpackhi_epi32(c4, c5);
+            Store(q, r0);
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(q + 16), lo45);
+            Store(q + 24, r1);
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(q + 40), _mm_unpackhi_epi64(lo45, lo45));
+            Store(q + 48, r2);
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(q + 64), hi45);
+            Store(q + 72, r3);
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(q + 88), _mm_unpackhi_epi64(hi45, hi45));
+        }
+        TransposeWords(src, dst, channels, words, n);
+    }
+}
+#endif
+
+#ifdef ADPCM_AVX2
+__attribute__((target("avx2")))
+static inline __m256i Load256(const uint8_t *p)
+{
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+}
+
+__attribute__((target("avx2")))
+static inline void Store256(uint8_t *p, __m256i v)
+{
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v);
+}
+
+//8 words of every channel per step; unpacks work per 128 bit lane, so the
+//rows come out split across lanes and get put back together at the end
+__attribute__((target("avx2")))
+static void DeinterleaveAvx2(const uint8_t *in, uint8_t *out, size_t blocks, unsigned int channels, size_t blockAlign)
+{
+    size_t words = blockAlign / (channels * 4u);
+    size_t stride = 4 * words;
+    for (size_t block = 0; block < blocks; block++)
+    {
+        const uint8_t *src = in + block * blockAlign;
+        uint8_t *dst = out + block * blockAlign;
+        size_t n = 0;
+        for (; n + 8 <= words; n += 8)
+        {
+            const uint8_t *p = src + 4 * n;
+            uint8_t *q = dst + 4 * n * channels;
+            __m256i c0 = Load256(p), c1 = Load256(p + stride);
+            __m256i lo01 = _mm256_unpacklo_epi32(c0, c1), hi01 = _mm256_unpackhi_epi32(c0, c1);
+            if (channels == 2)
+            {
+                Store256(q, _mm256_permute2x128_si256(lo01, hi01, 0x20));
+                Store256(q + 32, _mm256_permute2x128_si256(lo01, hi01, 0x31));
+                continue;
+            }
+            __m256i c2 = Load256(p + 2 * stride), c3 = Load256(p + 3 * stride);
+            __m256i lo23 = _mm256_unpacklo_epi32(c2, c3), hi23 = _mm256_unpackhi_epi32(c2, c3);
+            __m256i r0 = _mm256_unpacklo_epi64(lo01, lo23), r1 = _mm256_unpackhi_epi64(lo01, lo23);
+            __m256i r2 = _mm256_unpacklo_epi64(hi01, hi23), r3 = _mm256_unpackhi_epi64(hi01, hi23);
+            Store256(q, _mm256_permute2x128_si256(r0, r1, 0x20));
+            Store256(q + 32, _mm256_permute2x128_si256(r2, r3, 0x20));
+            Store256(q + 64, _mm256_permute2x128_si256(r0, r1, 0x31));
+            Store256(q + 96, _mm256_permute2x128_si256(r2, r3, 0x31));
+        }
+        TransposeWords(src, dst, channels, words, n);
+    }
+}
+#endif
+
+#ifdef ADPCM_NEON
+//4 words of every channel per step; the interleaving stores do the transpose
+static void DeinterleaveNeon(const uint8_t *in, uint8_t *out, size_t blocks, unsigned int channels, size_t blockAlign)
+{
+    size_t words = blockAlign / (channels * 4u);
+    size_t stride = 4 * words;
+    for (size_t block = 0; block < blocks; block++)
+    {
+        const uint8_t *src = in + block * blockAlign;
+        uint8_t *dst = out + block * blockAlign;
+        size_t n = 0;
+        for (; n + 4 <= words; n += 4)
+        {
+            const uint8_t *p = src + 4 * n;
+            uint32_t *q = reinterpret_cast<uint32_t *>(dst + 4 * n * channels);
+            if (channels == 2)
+            {
+                uint32x4x2_t v = { { vld1q_u32(reinterpret_cast<const uint32_t *>(p)), vld1q_u32(reinterpret_cast<const uint32_t *>(p + stride)) } };
+                vst2q_u32(q, v);
+            }
+            else if (channels == 4)
+            {
+                uint32x4x4_t v = { { vld1q_u32(reinterpret_cast<const uint32_t *>(p)), vld1q_u32(reinterpret_cast<const uint32_t *>(p + stride)),
+                    vld1q_u32(reinterpret_cast<const uint32_t *>(p + 2 * stride)), vld1q_u32(reinterpret_cast<const uint32_t *>(p + 3 * stride)) } };
+                vst4q_u32(q, v);
+            }
+            else
+            {
+                //6 channels as three interleaved streams of channel pairs
+                uint32x4x2_t p01 = vzipq_u32(vld1q_u32(reinterpret_cast<const uint32_t *>(p)), vld1q_u32(reinterpret_cast<const uint32_t *>(p + stride)));
+                uint32x4x2_t p23 = vzipq_u32(vld1q_u32(reinterpret_cast<const uint32_t *>(p + 2 * stride)), vld1q_u32(reinterpret_cast<const uint32_t *>(p + 3 * stride)));
+                uint32x4x2_t p45 = vzipq_u32(vld1q_u32(reinterpret_cast<const uint32_t *>(p + 4 * stride)), vld1q_u32(reinterpret_cast<const uint32_t *>(p + 5 * stride)));
+                uint64x2x3_t first = { { vreinterpretq_u64_u32(p01.val[0]), vreinterpretq_u64_u32(p23.val[0]), vreinterpretq_u64_u32(p45.val[0]) } };
+                uint64x2x3_t second = { { vreinterpretq_u64_u32(p01.val[1]), vreinterpretq_u64_u32(p23.val[1]), vreinterpretq_u64_u32(p45.val[1]) } };
+                vst3q_u64(reinterpret_cast<uint64_t *>(q), first);
+                vst3q_u64(reinterpret_cast<uint64_t *>(q + 12), second);
+            }
+        }
+        TransposeWords(src, dst, channels, words, n);
+    }
+}
+#endif
+
+void DeinterleaveAdpcmBlocks(const uint8_t *in, uint8_t *out, size_t blocks, unsigned int channels, size_t blockAlign)
+{
+    if ((channels != 2 && channels != 4 && channels != 6) || blockAlign % (channels * 4u) != 0)
+    {
+        DeinterleaveAdpcmBlocksScalar(in, out, blocks, channels, blockAlign);
+        return;
+    }
+#ifdef ADPCM_AVX2
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    if (avx2 && channels != 6)
+    {
+        DeinterleaveAvx2(in, out, blocks, channels, blockAlign);
+        return;
+    }
+#endif
+#if defined(ADPCM_SSE2)
+    DeinterleaveSse2(in, out, blocks, channels, blockAlign);
+#elif defined(ADPCM_NEON)
+    DeinterleaveNeon(in, out, blocks, channels, blockAlign);
+#else
+    DeinterleaveAdpcmBlocksScalar(in, out, blocks, channels, blockAlign);
+#endif
+}
+
+static const int32_t imaStepTable[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31,
+    34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143,
+    157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658,
+    724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024,
+    3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const int32_t imaIndexTable[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+
+size_t AdpcmSamplesPerBlock(unsigned int channels, size_t blockAlign)
+{
+    return (blockAlign / channels - 4) * 2 + 1;
+}
+
+//one channel of one block: bytes of header and nibbles, samples written
+//every stride entries of out
+static void DecodeStream(const uint8_t *in, size_t bytes, int16_t *out, unsigned int stride)
+{
+    int32_t pred = static_cast<int16_t>(in[0] | in[1] << 8);
+    int32_t index = std::min<int32_t>(in[2], 88);
+    *out = static_cast<int16_t>(pred);
+    for (size_t i = 4; i < bytes; i++)
+    {
+        for (unsigned int shift = 0; shift < 8; shift += 4)
+        {
+            int32_t nibble = (in[i] >> shift) & 15;
+            int32_t step = imaStepTable[index];
+            int32_t diff = step >> 3;
+            if (nibble & 1)
+                diff += step >> 2;
+            if (nibble & 2)
+                diff += step >> 1;
+            if (nibble & 4)
+                diff += step;
+            if (nibble & 8)
+                diff = -diff;
+            pred = std::max(-32768, std::min(32767, pred + diff));
+            index = std::max(0, std::min(88, index + imaIndexTable[nibble & 7]));
+            out += stride;
+            *out = static_cast<int16_t>(pred);
+        }
+    }
+}
+
+//streams first to last of the blocks at in: stream i is channel i % channels of block i / channels
+static void DecodeStreamsScalar(const uint8_t *in, int16_t *out, size_t first, size_t last, unsigned int channels, size_t blockAlign)
+{
+    size_t bytes = blockAlign / channels;
+    size_t samples = AdpcmSamplesPerBlock(channels, blockAlign);
+    for (size_t i = first; i < last; i++)
+    {
+        size_t block = i / channels, channel = i % channels;
+        DecodeStream(in + block * blockAlign + channel * bytes, bytes, out + block * samples * channels + channel, channels);
+    }
+}
+
+void DecodeAdpcmBlocksScalar(const uint8_t *in, int16_t *out, size_t blocks, unsigned int channels, size_t blockAlign)
+{
+    DecodeStreamsScalar(in, out, 0, blocks * channels, channels, blockAlign);
+}
+
+#ifdef ADPCM_AVX2
+//eight streams side by side, one per lane. Every channel of every block is
+//independent, so mono decodes eight blocks at once and 8 channels one block.
+__attribute__((target("avx2")))
+static void DecodeStreamsAvx2(const uint8_t *in, int16_t *out, size_t first, size_t last, unsigned int channels, size_t blockAlign)
+{
+    size_t bytes = blockAlign / channels;
+    size_t samples = AdpcmSamplesPerBlock(channels, blockAlign);
+    const __m256i indexTable = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(imaIndexTable));
+    const __m256i one = _mm256_set1_epi32(1), two = _mm256_set1_epi32(2), four = _mm256_set1_epi32(4), eight = _mm256_set1_epi32(8);
+    const __m256i nibbleMask = _mm256_set1_epi32(15), seven = _mm256_set1_epi32(7);
+    const __m256i minSample = _mm256_set1_epi32(-32768), maxSample = _mm256_set1_epi32(32767), maxIndex = _mm256_set1_epi32(88);
+    size_t i = first;
+    for (; i + 8 <= last; i += 8)
+    {
+        //byte offsets of the eight streams from the first one; at most 8 blocks apart
+        const uint8_t *base = in + (i / channels) * blockAlign + (i % channels) * bytes;
+        alignas(32) int32_t offsets[8];
+        int16_t *outs[8];
+        for (unsigned int lane = 0; lane < 8; lane++)
+        {
+            size_t block = (i + lane) / channels, channel = (i + lane) % channels;
+            offsets[lane] = static_cast<int32_t>(in + block * blockAlign + channel * bytes - base);
+            outs[lane] = out + block * samples * channels + channel;
+        }
+        __m256i offset = _mm256_load_si256(reinterpret_cast<const __m256i *>(offsets));
+        __m256i header = _mm256_i32gather_epi32(reinterpret_cast<const int *>(base), offset, 1);
+        __m256i pred = _mm256_srai_epi32(_mm256_slli_epi32(header, 16), 16);
+        __m256i index = _mm256_min_epi32(_mm256_and_si256(_mm256_srli_epi32(header, 16), _mm256_set1_epi32(255)), maxIndex);
+        alignas(32) int32_t decoded[8];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(decoded), pred);
+        for (unsigned int lane = 0; lane < 8; lane++)
+        {
+            outs[lane][0] = static_cast<int16_t>(decoded[lane]);
+        }
+        size_t sample = 1;
+        for (size_t word = 4; word < bytes; word += 4)
+        {
+            offset = _mm256_add_epi32(offset, four);
+            __m256i nibbles = _mm256_i32gather_epi32(reinterpret_cast<const int *>(base), offset, 1);
+            for (unsigned int k = 0; k < 8; k++, sample++)
+            {
+                __m256i nibble = _mm256_and_si256(nibbles, nibbleMask);
+                nibbles = _mm256_srli_epi32(nibbles, 4);
+                __m256i step = _mm256_i32gather_epi32(imaStepTable, index, 4);
+                __m256i diff = _mm256_srai_epi32(step, 3);
+                diff = _mm256_add_epi32(diff, _mm256_and_si256(_mm256_cmpeq_epi32(_mm256_and_si256(nibble, one), one), _mm256_srai_epi32(step, 2)));
+                diff = _mm256_add_epi32(diff, _mm256_and_si256(_mm256_cmpeq_epi32(_mm256_and_si256(nibble, two), two), _mm256_srai_epi32(step, 1)));
+                diff = _mm256_add_epi32(diff, _mm256_and_si256(_mm256_cmpeq_epi32(_mm256_and_si256(nibble, four), four), step));
+                __m256i negate = _mm256_cmpeq_epi32(_mm256_and_si256(nibble, eight), eight);
+                diff = _mm256_sub_epi32(_mm256_xor_si256(diff, negate), negate);
+                pred = _mm256_max_epi32(minSample, _mm256_min_epi32(maxSample, _mm256_add_epi32(pred, diff)));
+                index = _mm256_add_epi32(index, _mm256_permutevar8x32_epi32(indexTable, _mm256_and_si256(nibble, seven)));
+                index = _mm256_max_epi32(_mm256_setzero_si256(), _mm256_min_epi32(maxIndex, index));
+                _mm256_store_si256(reinterpret_cast<__m256i *>(decoded), pred);
+                for (unsigned int lane = 0; lane < 8; lane++)
+                {
+                    outs[lane][sample * channels] = static_cast<int16_t>(decoded[lane]);
+                }
+            }
+        }
+    }
+    DecodeStreamsScalar(in, out, i, last, channels, blockAlign);
+}
+#endif
+
+static void DecodeStreams(const uint8_t *in, int16_t *out, size_t first, size_t last, unsigned int channels, size_t blockAlign)
+{
+#ifdef ADPCM_AVX2
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    if (avx2)
+    {
+        DecodeStreamsAvx2(in, out, first, last, channels, blockAlign);
+        return;
+    }
+#endif
+    DecodeStreamsScalar(in, out, first, last, channels, blockAlign);
+}
+
+void DecodeAdpcmBlocks(const uint8_t *in, int16_t *out, size_t blocks, unsigned int channels, size_t blockAlign, unsigned int threads)
+{
+    //below this many blocks per thread, starting the thread costs more than it saves
+    const size_t minBlocks = 4096;
+    threads = static_cast<unsigned int>(std::max<size_t>(1, std::min<size_t>(threads, blocks / minBlocks)));
+    size_t perThread = (blocks + threads - 1) / threads;
+    std::vector<std::thread> workers;
+    for (unsigned int t = 1; t < threads; t++)
+    {
+        size_t begin = std::min(blocks, t * perThread), end = std::min(blocks, begin + perThread);
+        workers.emplace_back(DecodeStreams, in, out, begin * channels, end * channels, channels, blockAlign);
+    }
+    DecodeStreams(in, out, 0, std::min(blocks, perThread) * channels, channels, blockAlign);
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef _ADPCM_H
+#define _ADPCM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+//Wwise stores each ADPCM block channel by channel; IMA ADPCM WAVs interleave
+//the channels 4 bytes (8 samples) at a time. Reorders `blocks` consecutive
+//blocks of blockAlign bytes from in to out (which must not overlap). Bytes
+//past the last whole word of a channel aren't written. 2, 4 and 6 channels
+//use SIMD where the CPU has it.
+void DeinterleaveAdpcmBlocks(const uint8_t *in, uint8_t *out, size_t blocks, unsigned int channels, size_t blockAlign);
+
+//the plain loop the SIMD versions must match
+void DeinterleaveAdpcmBlocksScalar(const uint8_t *in, uint8_t *out, size_t blocks, unsigned int channels, size_t blockAlign);
+
+//samples per channel in one block of 4 bit Wwise ADPCM
+size_t AdpcmSamplesPerBlock(unsigned int channels, size_t blockAlign);
+
+//decodes `blocks` Wwise ADPCM blocks to interleaved 16 bit PCM. In a block
+//each channel has blockAlign / channels bytes, a 4 byte header (first sample,
+//step index) followed by its nibbles, low one first; blockAlign must be a
+//multiple of 4 * channels. out holds blocks * AdpcmSamplesPerBlock() *
+//channels samples. Large inputs are split over up to `threads` threads.
+void DecodeAdpcmBlocks(const uint8_t *in, int16_t *out, size_t blocks, unsigned int channels, size_t blockAlign, unsigned int threads = 1);
+
+//one channel of one block at a time on the calling thread, for comparison
+void DecodeAdpcmBlocksScalar(const uint8_t *in, int16_t *out, size_t blocks, unsigned int channels, size_t blockAlign);
+
+#endif // _ADPCM_H
@@ -0,0 +1,87 @@
+/*
+soundextract
+Copyright 2018 Jonathan wilson
+Copyright 2020 Sławomir Śpiewak
+
+Soundextract is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version. See the file COPYING for more details.
+*/
+
+//Wwise ADPCM decode throughput: soundextract-adpcmbench [seconds per case]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+#include "adpcm.h"
+
+//Wwise writes 36 bytes per channel per block, 65 samples
+static const size_t channelBytes = 36;
+
+//a buffer of random nibbles behind valid block headers
+static std::vector<uint8_t> MakeBlocks(size_t blocks, unsigned int channels, std::mt19937 &rng)
+{
+    std::vector<uint8_t> data(blocks * channels * channelBytes);
+    for (auto &b : data)
+    {
+        b = static_cast<uint8_t>(rng());
+    }
+    for (size_t i = 0; i < blocks * channels; i++)
+    {
+        data[i * channelBytes + 2] %= 89;
+        data[i * channelBytes + 3] = 0;
+    }
+    return data;
+}
+
+//millions of samples (all channels) per second, run for roughly the given time
+template <typename Decode>
+static double Measure(Decode decode, size_t samples, double seconds)
+{
+    typedef std::chrono::steady_clock Clock;
+    size_t runs = 0;
+    Clock::time_point start = Clock::now();
+    double elapsed = 0;
+    do
+    {
+        decode();
+        runs++;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (elapsed < seconds);
+    return static_cast<double>(samples) * runs / elapsed / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 0.5;
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    std::mt19937 rng(1);
+    const size_t blocks = 32768;
+
+    printf("%-9s %14s %14s %14s\n", "channels", "scalar", "decoder", "threads");
+    for (unsigned int channels : { 1u, 2u, 6u })
+    {
+        size_t blockAlign = channels * channelBytes;
+        std::vector<uint8_t> data = MakeBlocks(blocks, channels, rng);
+        size_t samples = blocks * AdpcmSamplesPerBlock(channels, blockAlign) * channels;
+        std::vector<int16_t> expected(samples), pcm(samples);
+
+        //every path has to agree with the reference before its speed means anything
+        DecodeAdpcmBlocksScalar(data.data(), expected.data(), blocks, channels, blockAlign);
+        DecodeAdpcmBlocks(data.data(), pcm.data(), blocks, channels, blockAlign, threads);
+        if (pcm != expected)
+        {
+            fprintf(stderr, "decoder mismatch with %u channels\n", channels);
+            return 1;
+        }
+
+        double scalar = Measure([&] { DecodeAdpcmBlocksScalar(data.data(), pcm.data(), blocks, channels, blockAlign); }, samples, seconds);
+        double single = Measure([&] { DecodeAdpcmBlocks(data.data(), pcm.data(), blocks, channels, blockAlign, 1); }, samples, seconds);
+        double threaded = Measure([&] { DecodeAdpcmBlocks(data.data(), pcm.data(), blocks, channels, blockAlign, threads); }, samples, seconds);
+        printf("%-9u %7.1f Msmp/s %7.1f Msmp/s %7.1f Msmp/s\n", channels, scalar, single, threaded);
+    }
+    return 0;
+}
@@ -0,0 +1,527 @@
+/*
+soundextract
+Copyright 2018 Jonathan wilson
+Copyright 2020 Sławomir Śpiewak
+
+Soundextract is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version. See the file COPYING for more details.
+*/
+
+//every conversion stage timed in one run: soundextract-bench [-t seconds] [-f filter] [-o results.json] [game dir]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <functional>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Bit_stream.h"
+#include "adpcm.h"
+#include "codebook.h"
+#include "crc.h"
+#include "exporter.h"
+#include "importdir.h"
+#include "wwriff.h"
+
+namespace fs = std::filesystem;
+
+int revorb(const char *fname);
+
+//work one pass of a benchmark got through
+struct Work
+{
+    uint64_t bytes = 0;
+    uint64_t items = 0;
+};
+
+struct Result
+{
+    std::string name;
+    std::string unit;           //what items counts
+    uint64_t iterations;
+    double seconds;
+    uint64_t bytes;
+    uint64_t items;
+};
+
+static std::vector<Result> results;
+static double minSeconds = 0.5;
+static const char *filter = nullptr;
+//the table goes to stderr when the JSON takes stdout
+static FILE *report = stdout;
+
+//repeat pass for at least minSeconds, and at least once
+static void Run(const char *name, const char *unit, const std::function<Work()> &pass)
+{
+    if (filter && !strstr(name, filter))
+    {
+        return;
+    }
+    typedef std::chrono::steady_clock Clock;
+    Result result = { name, unit, 0, 0, 0, 0 };
+    Clock::time_point start = Clock::now();
+    do
+    {
+        Work work = pass();
+        result.bytes += work.bytes;
+        result.items += work.items;
+        result.iterations++;
+        result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (result.seconds < minSeconds);
+    fprintf(report, "%-28s %10.1f MB/s %14.0f %s/s\n", name, result.bytes / result.seconds / 1e6, result.items / result.seconds, unit);
+    fflush(report);
+    results.push_back(result);
+}
+
+//counts the packets a Bit_oggstream hands over instead of paging them
+class Counting_sink : public Ogg_packet_sink
+{
+public:
+    uint64_t bytes = 0;
+    uint64_t packets = 0;
+    void packet(const unsigned char *, unsigned int size, uint32_t, bool, bool) override
+    {
+        bytes += size;
+        packets++;
+    }
+};
+
+//drops everything written, counting it
+class Null_streambuf : public std::streambuf
+{
+public:
+    uint64_t bytes = 0;
+
+protected:
+    int_type overflow(int_type c) override
+    {
+        bytes++;
+        return traits_type::not_eof(c);
+    }
+    std::streamsize xsputn(const char *, std::streamsize n) override
+    {
+        bytes += n;
+        return n;
+    }
+};
+
+static std::vector<unsigned char> RandomBytes(size_t size, std::mt19937 &rng)
+{
+    std::vector<unsigned char> data(size);
+    for (auto &b : data)
+    {
+        b = static_cast<unsigned char>(rng());
+    }
+    return data;
+}
+
+static void SyntheticBenchmarks()
+{
+    std::mt19937 rng(1);
+    std::vector<unsigned char> data = RandomBytes(1 << 22, rng);
+    //field widths the way audio packets and codebooks mix them
+    std::vector<unsigned char> widths(4096);
+    for (auto &width : widths)
+    {
+        width = static_cast<unsigned char>(1 + rng() % 24);
+    }
+    volatile uint64_t sink = 0;
+
+    Run("bitstream/get_bits", "fields", [&]()
+    {
+        Bit_stream bits(data.data(), data.size());
+        uint64_t sum = 0, fields = 0;
+        size_t limit = data.size() * 8 - 32;
+        for (size_t i = 0; bits.get_total_bits_read() < limit; i = (i + 1) % widths.size(), fields++)
+        {
+            sum += bits.get_bits(widths[i]);
+        }
+        sink = sink + sum;
+        return Work{ data.size(), fields };
+    });
+
+    Run("bitstream/put_bits", "fields", [&]()
+    {
+        Counting_sink packets;
+        Bit_oggstream os(packets);
+        uint64_t fields = 0;
+        size_t w = 0;
+        for (size_t i = 0; i + 4 <= data.size(); i += 4, w = (w + 1) % widths.size(), fields++)
+        {
+            uint32_t value;
+            memcpy(&value, &data[i], 4);
+            os.put_bits(value, widths[w]);
+            //pages hold 64 KiB at most
+            if ((fields & 8191) == 8191)
+            {
+                os.flush_page();
+            }
+        }
+        os.flush_page();
+        return Work{ packets.bytes, fields };
+    });
+
+    //4 KiB packets paged, checksummed and written to a stream
+    Run("bitstream/ogg_pages", "pages", [&]()
+    {
+        Null_streambuf buf;
+        std::ostream out(&buf);
+        Bit_oggstream os(out);
+        uint64_t pages = 0;
+        for (size_t i = 0; i + 4096 <= data.size(); i += 4096, pages++)
+        {
+            os.put_bytes(&data[i], 4096);
+            os.flush_page();
+        }
+        return Work{ buf.bytes, pages };
+    });
+
+    Run("crc/checksum", "pages", [&]()
+    {
+        uint32_t crc = 0;
+        uint64_t pages = 0;
+        for (size_t i = 0; i + 4096 <= data.size(); i += 4096, pages++)
+        {
+            crc ^= checksum(&data[i], 4096);
+        }
+        sink = sink + crc;
+        return Work{ pages * 4096, pages };
+    });
+
+    Run("codebook/rebuild", "codebooks", [&]()
+    {
+        codebook_library library;
+        Counting_sink packets;
+        Bit_oggstream os(packets);
+        uint64_t codebooks = 0, bytes = 0;
+        for (int i = 0; library.get_codebook_size(i) >= 0; i++, codebooks++)
+        {
+            library.rebuild(i, os);
+            bytes += library.get_codebook_size(i);
+            os.flush_page();
+        }
+        return Work{ bytes, codebooks };
+    });
+
+    //stereo Wwise blocks, 36 bytes per channel
+    const size_t blockAlign = 72;
+    size_t blocks = data.size() / blockAlign;
+    std::vector<unsigned char> planar(blocks * blockAlign);
+    Run("adpcm/deinterleave", "blocks", [&]()
+    {
+        DeinterleaveAdpcmBlocks(data.data(), planar.data(), blocks, 2, blockAlign);
+        sink = sink + planar[blocks];
+        return Work{ blocks * blockAlign, blocks };
+    });
+}
+
+//a Vorbis wem from the game, in memory
+struct VorbisWem
+{
+    std::string name;
+    std::vector<char> data;
+};
+
+static void GameBenchmarks(const std::string &root, const fs::path &scratch)
+{
+    GameAudio game;
+    if (!ImportDirectory(root, game, std::string()) || game.sounds.empty())
+    {
+        fprintf(stderr, "%s: no SoundbanksInfo sounds found\n", root.c_str());
+        return;
+    }
+    ExportSession session;
+    std::set<std::string> banks;
+    for (const auto &sound : game.sounds)
+    {
+        banks.insert(sound.bankPath);
+    }
+    for (const auto &bank : banks)
+    {
+        session.index.AddBank(bank);
+    }
+
+    //every sound wwriff takes, read once up front
+    std::vector<VorbisWem> wems;
+    for (const auto &sound : game.sounds)
+    {
+        SoundInput input;
+        if (!ReadSound(sound, session.index, input))
+        {
+            continue;
+        }
+        try
+        {
+            Wwise_RIFF_Vorbis ww(input.data, input.size, sound.name);
+            wems.push_back(VorbisWem{ sound.name, std::vector<char>(input.data, input.data + input.size) });
+        }
+        catch (...)
+        {
+        }
+    }
+    fprintf(report, "# %zu sounds, %zu Vorbis, %zu banks\n", game.sounds.size(), wems.size(), banks.size());
+
+    if (!wems.empty())
+    {
+        Run("wwriff/generate_ogg_header", "headers", [&]()
+        {
+            uint64_t bytes = 0;
+            for (const auto &wem : wems)
+            {
+                Wwise_RIFF_Vorbis ww(wem.data.data(), static_cast<long>(wem.data.size()), wem.name);
+                Counting_sink packets;
+                Bit_oggstream os(packets);
+                bool *modeBlockflag = nullptr;
+                int modeBits = 0;
+                try
+                {
+                    if (ww.needs_revorb())
+                        ww.generate_ogg_header_with_triad(os);
+                    else
+                        ww.generate_ogg_header(os, modeBlockflag, modeBits);
+                }
+                catch (...)
+                {
+                }
+                delete [] modeBlockflag;
+                bytes += packets.bytes;
+            }
+            return Work{ bytes, wems.size() };
+        });
+
+        //header plus the audio packet loop, without paging
+        Run("wwriff/generate_packets", "sounds", [&]()
+        {
+            uint64_t bytes = 0;
+            for (const auto &wem : wems)
+            {
+                Wwise_RIFF_Vorbis ww(wem.data.data(), static_cast<long>(wem.data.size()), wem.name);
+                Counting_sink packets;
+                try
+                {
+                    ww.generate_packets(packets);
+                }
+                catch (...)
+                {
+                }
+                bytes += wem.data.size();
+            }
+            return Work{ bytes, wems.size() };
+        });
+
+        Run("wwriff/generate_ogg", "sounds", [&]()
+        {
+            uint64_t bytes = 0;
+            for (const auto &wem : wems)
+            {
+                Wwise_RIFF_Vorbis ww(wem.data.data(), static_cast<long>(wem.data.size()), wem.name);
+                Null_streambuf buf;
+                std::ostream out(&buf);
+                try
+                {
+                    ww.generate_ogg(out);
+                }
+                catch (...)
+                {
+                }
+                bytes += wem.data.size();
+            }
+            return Work{ bytes, wems.size() };
+        });
+
+        //revorb rewrites in place, so the same Oggs serve every pass
+        std::vector<std::string> oggs;
+        uint64_t oggBytes = 0;
+        fs::create_directories(scratch / "revorb");
+        for (size_t i = 0; i < wems.size(); i++)
+        {
+            std::vector<char> ogg;
+            try
+            {
+                Wwise_RIFF_Vorbis ww(wems[i].data.data(), static_cast<long>(wems[i].data.size()), wems[i].name);
+                vector_streambuf buf(ogg);
+                std::ostream out(&buf);
+                ww.generate_ogg(out);
+            }
+            catch (...)
+            {
+                continue;
+            }
+            SoundOutput output;
+            output.fileName = (scratch / "revorb" / (std::to_string(i) + ".ogg")).string();
+            output.data = std::move(ogg);
+            if (WriteSound(output))
+            {
+                oggs.push_back(output.fileName);
+                oggBytes += output.data.size();
+            }
+        }
+        Run("revorb", "files", [&]()
+        {
+            for (const auto &ogg : oggs)
+            {
+                revorb(ogg.c_str());
+            }
+            return Work{ oggBytes, oggs.size() };
+        });
+    }
+
+    Run("bank/LoadBank", "banks", [&]()
+    {
+        uint64_t bytes = 0;
+        for (const auto &path : banks)
+        {
+            SoundBank bank;
+            if (LoadBank(path, bank))
+            {
+                bytes += bank.dataSize;
+            }
+        }
+        return Work{ bytes, banks.size() };
+    });
+
+    //whole runs over every sound found, as the command line tool does them
+    uint64_t inputBytes = 0;
+    for (const auto &sound : game.sounds)
+    {
+        SoundInput input;
+        if (ReadSound(sound, session.index, input))
+            inputBytes += static_cast<uint64_t>(input.size);
+    }
+    session.sounds = game.sounds;
+    session.incremental = false;
+    const struct
+    {
+        const char *name;
+        unsigned int queueDepth;
+    } exports[] = {
+        { "export/stealing", 0 },
+        { "export/pipeline", 32 },
+    };
+    for (const auto &variant : exports)
+    {
+        session.queueDepth = variant.queueDepth;
+        session.dirExport = (scratch / "export").string();
+        Run(variant.name, "sounds", [&]()
+        {
+            ExportSounds(session);
+            return Work{ inputBytes, session.sounds.size() };
+        });
+    }
+}
+
+static void JsonString(FILE *f, const std::string &s)
+{
+    fputc('"', f);
+    for (unsigned char c : s)
+    {
+        if (c == '"' || c == '\\')
+            fprintf(f, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(f, "\\u%04x", c);
+        else
+            fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+static bool WriteJson(const std::string &fileName, const std::string &corpus)
+{
+    FILE *f = fileName == "-" ? stdout : fopen(fileName.c_str(), "w");
+    if (!f)
+    {
+        return false;
+    }
+    char date[32];
+    time_t now = time(nullptr);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    fprintf(f, "{\n  \"date\": \"%s\",\n  \"compiler\": ", date);
+    JsonString(f, __VERSION__);
+#ifdef NDEBUG
+    fprintf(f, ",\n  \"build\": \"release\"");
+#else
+    fprintf(f, ",\n  \"build\": \"debug\"");
+#endif
+    fprintf(f, ",\n  \"threads\": %u,\n  \"min_seconds\": %g,\n  \"corpus\": ", std::thread::hardware_concurrency(), minSeconds);
+    JsonString(f, corpus);
+    fprintf(f, ",\n  \"results\": [");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const Result &r = results[i];
+        fprintf(f, "%s\n    {\"name\": ", i ? "," : "");
+        JsonString(f, r.name);
+        fprintf(f, ", \"unit\": ");
+        JsonString(f, r.unit);
+        fprintf(f, ", \"iterations\": %llu, \"seconds\": %.6f, \"bytes\": %llu, \"items\": %llu, \"mb_per_s\": %.3f, \"items_per_s\": %.3f}",
+            static_cast<unsigned long long>(r.iterations), r.seconds, static_cast<unsigned long long>(r.bytes), static_cast<unsigned long long>(r.items),
+            r.bytes / r.seconds / 1e6, r.items / r.seconds);
+    }
+    fprintf(f, "\n  ]\n}\n");
+    return f == stdout ? fflush(f) == 0 : fclose(f) == 0;
+}
+
+static void Usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [-t seconds] [-f filter] [-o results.json] [game dir]\n", argv0);
+    fprintf(stderr, "  -t S    run each benchmark for at least S seconds (default: 0.5)\n");
+    fprintf(stderr, "  -f F    only run benchmarks whose name contains F\n");
+    fprintf(stderr, "  -o F    write results as JSON to F, - for stdout\n");
+    fprintf(stderr, "  a game dir (soundextract-corpusgen makes one) adds the wwriff, revorb, bank\n");
+    fprintf(stderr, "  and export benchmarks over its sounds\n");
+}
+
+int main(int argc, char *argv[])
+{
+    std::string jsonName, corpus;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-t") && i + 1 < argc)
+        {
+            minSeconds = atof(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-f") && i + 1 < argc)
+        {
+            filter = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+        {
+            jsonName = argv[++i];
+        }
+        else if (argv[i][0] == '-' || !corpus.empty())
+        {
+            Usage(argv[0]);
+            return 1;
+        }
+        else
+        {
+            corpus = fs::absolute(argv[i]).lexically_normal().string();
+        }
+    }
+
+    if (jsonName == "-")
+    {
+        report = stderr;
+    }
+    SyntheticBenchmarks();
+    if (!corpus.empty())
+    {
+        fs::path scratch = fs::temp_directory_path() / ("soundextract-bench-" + std::to_string(std::random_device()()));
+        GameBenchmarks(corpus, scratch);
+        std::error_code ec;
+        fs::remove_all(scratch, ec);
+    }
+
+    if (!jsonName.empty() && !WriteJson(jsonName, corpus))
+    {
+        fprintf(stderr, "%s: cannot write results\n", jsonName.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,154 @@
+#ifndef _BOUNDEDQUEUE_H
+#define _BOUNDEDQUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <utility>
+
+//fixed-size multi-producer multi-consumer FIFO; each slot carries a sequence
+//number telling producers and consumers whose turn it is (D. Vyukov's
+//bounded queue), so neither side takes a lock. Push and Pop wait by spinning,
+//then yielding, then sleeping briefly.
+template <typename T>
+class BoundedQueue
+{
+public:
+    //capacity is rounded up to a power of two
+    explicit BoundedQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+        {
+            size *= 2;
+        }
+        mask = size - 1;
+        slots.reset(new Slot[size]);
+        for (size_t i = 0; i < size; i++)
+        {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+    BoundedQueue(const BoundedQueue &) = delete;
+    BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+    bool TryPush(T &value)
+    {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Slot &slot = slots[pos & mask];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            ptrdiff_t diff = static_cast<ptrdiff_t>(sequence) - static_cast<ptrdiff_t>(pos);
+            if (diff == 0)
+            {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    slot.value = std::move(value);
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;   //full
+            }
+            else
+            {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool TryPop(T &value)
+    {
+        size_t pos = head.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Slot &slot = slots[pos & mask];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            ptrdiff_t diff = static_cast<ptrdiff_t>(sequence) - static_cast<ptrdiff_t>(pos + 1);
+            if (diff == 0)
+            {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    value = std::move(slot.value);
+                    slot.sequence.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;   //empty
+            }
+            else
+            {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void Push(T &value)
+    {
+        for (unsigned int attempt = 0; !TryPush(value); attempt++)
+        {
+            Wait(attempt);
+        }
+    }
+
+    //false once the queue is closed and drained
+    bool Pop(T &value)
+    {
+        for (unsigned int attempt = 0;; attempt++)
+        {
+            if (TryPop(value))
+            {
+                return true;
+            }
+            if (closed.load(std::memory_order_acquire))
+            {
+                //anything pushed before Close is visible now
+                return TryPop(value);
+            }
+            Wait(attempt);
+        }
+    }
+
+    //no more pushes; consumers drain what's left
+    void Close()
+    {
+        closed.store(true, std::memory_order_release);
+    }
+
+private:
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    static void Wait(unsigned int attempt)
+    {
+        if (attempt < 64)
+        {
+            return;
+        }
+        if (attempt < 128)
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+    std::atomic<bool> closed{false};
+};
+
+#endif // _BOUNDEDQUEUE_H
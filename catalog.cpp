@@ -0,0 +1,301 @@
+/*
+soundextract
+Copyright 2018 Jonathan wilson
+Copyright 2020 Sławomir Śpiewak
+
+Soundextract is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version. See the file COPYING for more details.
+*/
+
+//binary cache of parsed SoundbanksInfo XMLs, and the sounds opened from them
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <thread>
+#include <unordered_map>
+#include "catalog.h"
+#include "hash.h"
+#include "perf.h"
+
+namespace fs = std::filesystem;
+
+//a catalog file is the header, the XML path it was made from, the sounds and
+//then the strings they point into, each string stored once. An XML that
+//isn't a SoundbanksInfo gets a catalog too, with no sounds, so it isn't
+//parsed again either.
+#pragma pack(push,1)
+struct CatalogHeader
+{
+    char magic[8];
+    uint64_t xmlSize;
+    uint64_t xmlTime;             //last write time in file clock ticks
+    UInt32 pathSize;
+    UInt32 soundCount;
+    UInt32 stringsSize;
+    UInt32 soundbanksInfo;        //0 when the XML wasn't one
+};
+
+struct CatalogString
+{
+    UInt32 offset;
+    UInt32 size;
+};
+
+struct CatalogSound
+{
+    CatalogString id;
+    CatalogString name;
+    CatalogString relativePath;
+    UInt32 streamed;
+};
+#pragma pack(pop)
+
+static const char catalogMagic[8] = { 'S', 'X', 'C', 'A', 'T', 'L', 'G', '2' };
+
+//the catalog file for an XML, named by a hash of its absolute path
+static fs::path CatalogFile(const std::string &cacheDir, const std::string &xmlPath)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016" PRIx64 ".cat", Hash64(xmlPath.data(), xmlPath.size()));
+    return fs::path(cacheDir) / name;
+}
+
+enum class CatalogRead
+{
+    Miss,               //no catalog, or one made from another XML
+    Sounds,
+    NotSoundbanksInfo
+};
+
+//append the catalog's sounds if it was made from this exact XML
+static CatalogRead ReadCatalog(const fs::path &file, const std::string &xmlPath, uint64_t xmlSize, uint64_t xmlTime, std::vector<Sound> &sounds)
+{
+    size_t size;
+    void *view = MapFile(file.string(), size);
+    if (!view)
+    {
+        return CatalogRead::Miss;
+    }
+    const char *data = static_cast<const char *>(view);
+    CatalogHeader header;
+    bool ok = size >= sizeof(header);
+    if (ok)
+    {
+        memcpy(&header, data, sizeof(header));
+        ok = !memcmp(header.magic, catalogMagic, sizeof(catalogMagic)) && header.xmlSize == xmlSize && header.xmlTime == xmlTime &&
+            header.pathSize == xmlPath.size() &&
+            size == sizeof(header) + header.pathSize + static_cast<size_t>(header.soundCount) * sizeof(CatalogSound) + header.stringsSize &&
+            !memcmp(data + sizeof(header), xmlPath.data(), xmlPath.size());
+    }
+    if (ok && !header.soundbanksInfo)
+    {
+        UnmapFile(view, size);
+        return CatalogRead::NotSoundbanksInfo;
+    }
+    if (ok)
+    {
+        const char *records = data + sizeof(header) + header.pathSize;
+        const char *strings = records + static_cast<size_t>(header.soundCount) * sizeof(CatalogSound);
+        auto valid = [&header](const CatalogString &s)
+        {
+            return s.offset <= header.stringsSize && s.size <= header.stringsSize - s.offset;
+        };
+        std::string bankPath = SoundbanksInfoBank(xmlPath);
+        size_t first = sounds.size();
+        sounds.reserve(first + header.soundCount);
+        for (UInt32 i = 0; i < header.soundCount; i++)
+        {
+            CatalogSound record;
+            memcpy(&record, records + i * sizeof(CatalogSound), sizeof(record));
+            if (!valid(record.id) || !valid(record.name) || !valid(record.relativePath))
+            {
+                sounds.resize(first);
+                ok = false;
+                break;
+            }
+            Sound sound;
+            sound.id.assign(strings + record.id.offset, record.id.size);
+            sound.name.assign(strings + record.name.offset, record.name.size);
+            sound.relativePath.assign(strings + record.relativePath.offset, record.relativePath.size);
+            sound.bankPath = bankPath;
+            sound.streamed = record.streamed != 0;
+            sounds.push_back(std::move(sound));
+        }
+    }
+    UnmapFile(view, size);
+    return ok ? CatalogRead::Sounds : CatalogRead::Miss;
+}
+
+//replace the catalog with sounds[first, end), or with a note that the XML
+//isn't a SoundbanksInfo; a failed write just leaves no cache
+static void WriteCatalog(const fs::path &file, const std::string &xmlPath, uint64_t xmlSize, uint64_t xmlTime, bool soundbanksInfo,
+    const std::vector<Sound> &sounds, size_t first)
+{
+    std::string strings;
+    std::unordered_map<std::string, CatalogString> stored;
+    auto store = [&](const std::string &s)
+    {
+        auto it = stored.find(s);
+        if (it == stored.end())
+        {
+            CatalogString ref = { static_cast<UInt32>(strings.size()), static_cast<UInt32>(s.size()) };
+            strings += s;
+            it = stored.emplace(s, ref).first;
+        }
+        return it->second;
+    };
+    std::vector<CatalogSound> records;
+    records.reserve(sounds.size() - first);
+    for (size_t i = first; i < sounds.size(); i++)
+    {
+        CatalogSound record;
+        record.id = store(sounds[i].id);
+        record.name = store(sounds[i].name);
+        record.relativePath = store(sounds[i].relativePath);
+        record.streamed = sounds[i].streamed;
+        records.push_back(record);
+    }
+    if (strings.size() > 0xFFFFFFFFu)
+    {
+        return;
+    }
+
+    CatalogHeader header;
+    memcpy(header.magic, catalogMagic, sizeof(catalogMagic));
+    header.xmlSize = xmlSize;
+    header.xmlTime = xmlTime;
+    header.pathSize = static_cast<UInt32>(xmlPath.size());
+    header.soundCount = static_cast<UInt32>(records.size());
+    header.stringsSize = static_cast<UInt32>(strings.size());
+    header.soundbanksInfo = soundbanksInfo;
+
+    std::error_code ec;
+    fs::create_directories(file.parent_path(), ec);
+    //written aside and renamed over, so readers never see half a catalog
+    fs::path temp = file;
+    temp += "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    FILE *out = fopen(temp.string().c_str(), "wb");
+    if (!out)
+    {
+        return;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1 && fwrite(xmlPath.data(), 1, xmlPath.size(), out) == xmlPath.size() &&
+        fwrite(records.data(), sizeof(CatalogSound), records.size(), out) == records.size() &&
+        fwrite(strings.data(), 1, strings.size(), out) == strings.size();
+    if (fclose(out) != 0 || !ok)
+    {
+        fs::remove(temp, ec);
+        return;
+    }
+    fs::rename(temp, file, ec);
+    if (ec)
+    {
+        fs::remove(temp, ec);
+    }
+}
+
+bool LoadSoundbanksInfo(const std::string &xmlName, std::vector<Sound> &sounds, const std::string &cacheDir, const WemSet *wems)
+{
+    size_t first = sounds.size();
+    if (cacheDir.empty())
+    {
+        if (!ParseSoundbanksInfoFile(xmlName, sounds))
+        {
+            return false;
+        }
+        DropMissingWems(sounds, first, wems);
+        return true;
+    }
+    std::error_code ec;
+    std::string xmlPath = fs::absolute(xmlName, ec).lexically_normal().generic_string();
+    uint64_t xmlSize = fs::file_size(xmlPath, ec);
+    if (ec)
+    {
+        return false;
+    }
+    uint64_t xmlTime = static_cast<uint64_t>(fs::last_write_time(xmlPath, ec).time_since_epoch().count());
+    if (ec)
+    {
+        return LoadSoundbanksInfo(xmlName, sounds, std::string(), wems);
+    }
+
+    fs::path file = CatalogFile(cacheDir, xmlPath);
+    CatalogRead read = ReadCatalog(file, xmlPath, xmlSize, xmlTime, sounds);
+    if (read == CatalogRead::Miss)
+    {
+        PERF_COUNT(CatalogCacheMisses, 1);
+        bool soundbanksInfo = ParseSoundbanksInfoFile(xmlPath, sounds);
+        WriteCatalog(file, xmlPath, xmlSize, xmlTime, soundbanksInfo, sounds, first);
+        if (!soundbanksInfo)
+        {
+            return false;
+        }
+    }
+    else
+    {
+        PERF_COUNT(CatalogCacheHits, 1);
+        if (read == CatalogRead::NotSoundbanksInfo)
+        {
+            return false;
+        }
+    }
+    DropMissingWems(sounds, first, wems);
+    return true;
+}
+
+std::string DefaultCatalogCacheDir()
+{
+    std::string base;
+#ifdef _WIN32
+    if (const char *local = getenv("LOCALAPPDATA"))
+        base = local;
+#else
+    if (const char *xdg = getenv("XDG_CACHE_HOME"))
+        base = xdg;
+    else if (const char *home = getenv("HOME"))
+        base = std::string(home) + "/.cache";
+#endif
+    if (base.empty())
+    {
+        return base;
+    }
+    return (fs::path(base) / "soundextract").generic_string();
+}
+
+SoundCatalog::Handle SoundCatalog::Add(std::vector<Sound> &&added)
+{
+    Handle first = static_cast<Handle>(sounds.size());
+    if (sounds.empty())
+    {
+        sounds = std::move(added);
+    }
+    else
+    {
+        sounds.insert(sounds.end(), std::make_move_iterator(added.begin()), std::make_move_iterator(added.end()));
+    }
+    added.clear();
+
+    auto byNameLess = [this](Handle h1, Handle h2)
+    {
+        int order = sounds[h1].name.compare(sounds[h2].name);
+        return order < 0 || (order == 0 && h1 < h2);
+    };
+    size_t merged = byName.size();
+    for (Handle handle = first; handle < sounds.size(); handle++)
+    {
+        byName.push_back(handle);
+    }
+    //batches usually come sorted already, then this only checks
+    if (!std::is_sorted(byName.begin() + merged, byName.end(), byNameLess))
+    {
+        std::sort(byName.begin() + merged, byName.end(), byNameLess);
+    }
+    std::inplace_merge(byName.begin(), byName.begin() + merged, byName.end(), byNameLess);
+    return first;
+}
@@ -0,0 +1,42 @@
+#ifndef _CATALOG_H
+#define _CATALOG_H
+
+#include <string>
+#include <vector>
+#include "soundbank.h"
+
+//ParseSoundbanksInfo backed by a cache of parsed XMLs in cacheDir. Each XML
+//gets one binary catalog, keyed by its path, size and modification time and
+//mapped straight in when it still matches, so tinyxml2 only sees new or
+//changed files. The missing .wem check still runs on every load, against
+//wems when given. An empty cacheDir parses without caching. Safe to call
+//from several threads.
+bool LoadSoundbanksInfo(const std::string &xmlName, std::vector<Sound> &sounds, const std::string &cacheDir, const WemSet *wems = nullptr);
+
+//per-user cache location: $XDG_CACHE_HOME, ~/.cache or %LOCALAPPDATA%,
+//plus /soundextract; empty if none of them is set
+std::string DefaultCatalogCacheDir();
+
+//every sound opened in a session. A handle is the sound's position in the
+//order it was added and never changes, so views can hold on to it instead
+//of looking sounds up by name. The name order is kept by merging each
+//added batch in rather than sorting everything again.
+class SoundCatalog
+{
+public:
+    typedef UInt32 Handle;
+
+    //take the sounds over; returns the handle of the first of them
+    Handle Add(std::vector<Sound> &&sounds);
+    const Sound &operator[](Handle handle) const { return sounds[handle]; }
+    size_t size() const { return sounds.size(); }
+    bool empty() const { return sounds.empty(); }
+    //every handle, sorted by name and then by handle
+    const std::vector<Handle> &ByName() const { return byName; }
+
+private:
+    std::vector<Sound> sounds;
+    std::vector<Handle> byName;
+};
+
+#endif // _CATALOG_H
@@ -0,0 +1,217 @@
+/*
+soundextract
+Copyright 2018 Jonathan wilson
+Copyright 2020 Sławomir Śpiewak
+
+Soundextract is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version. See the file COPYING for more details.
+*/
+
+//headless extractor: soundextract-cli [-j N] [-q N] [--no-io-uring] [--revorb] [--decode-adpcm] [--decode-vorbis] [--force] [--no-catalog-cache] -o <outdir> <xml or dir>...
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "catalog.h"
+#include "exporter.h"
+#include "importdir.h"
+#include "perf.h"
+
+namespace fs = std::filesystem;
+
+//the export Ctrl-C stops; workers finish the sound they're on and the manifest is saved
+static ExportJob *interruptible = nullptr;
+
+static void Interrupt(int)
+{
+    if (interruptible)
+        interruptible->Cancel();
+}
+
+static void Usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [-j N] [-q N] [--no-io-uring] [--revorb] [--decode-adpcm] [--decode-vorbis] [--force] [--no-catalog-cache] -o <output dir> <SoundbanksInfo xml or game dir>...\n", argv0);
+    fprintf(stderr, "  -j N       worker threads (default: hardware concurrency)\n");
+    fprintf(stderr, "  -q N       read, convert and write on separate threads, N sounds queued\n");
+    fprintf(stderr, "             between each (default: 0, each worker does all three)\n");
+    fprintf(stderr, "  --no-io-uring  with -q, read and write with stdio even where io_uring works\n");
+    fprintf(stderr, "  --revorb   rerun revorb on every Ogg to check the granules\n");
+    fprintf(stderr, "  --decode-adpcm  write ADPCM sounds as 16 bit PCM WAVs\n");
+    fprintf(stderr, "  --decode-vorbis  write Vorbis sounds as 16 bit PCM WAVs, not Oggs\n");
+    fprintf(stderr, "  --force    rewrite sounds the output manifest says are up to date\n");
+    fprintf(stderr, "  --no-catalog-cache  parse every XML instead of using cached catalogs\n");
+#ifdef SOUNDEXTRACT_PERF_COUNTERS
+    fprintf(stderr, "  --perf     print time spent per stage and event counts when done\n");
+    fprintf(stderr, "  --perf-json FILE  write them to FILE as JSON instead (- for stdout)\n");
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+    ExportSession session;
+    session.jobs = std::thread::hardware_concurrency();
+    std::vector<std::string> inputs;
+    std::string cacheDir = DefaultCatalogCacheDir();
+#ifdef SOUNDEXTRACT_PERF_COUNTERS
+    bool perf = false;
+    std::string perfJson;
+#endif
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-o") && i + 1 < argc)
+        {
+            session.dirExport = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-j") && i + 1 < argc)
+        {
+            session.jobs = static_cast<unsigned int>(atoi(argv[++i]));
+        }
+        else if (!strncmp(argv[i], "-j", 2) && argv[i][2])
+        {
+            session.jobs = static_cast<unsigned int>(atoi(argv[i] + 2));
+        }
+        else if (!strcmp(argv[i], "-q") && i + 1 < argc)
+        {
+            session.queueDepth = static_cast<unsigned int>(atoi(argv[++i]));
+        }
+        else if (!strcmp(argv[i], "--no-io-uring"))
+        {
+            session.ioUring = false;
+        }
+        else if (!strcmp(argv[i], "--revorb"))
+        {
+            session.options.revorbPass = true;
+        }
+        else if (!strcmp(argv[i], "--decode-adpcm"))
+        {
+            session.options.decodeAdpcm = true;
+        }
+        else if (!strcmp(argv[i], "--decode-vorbis"))
+        {
+            session.options.decodeVorbis = true;
+        }
+        else if (!strcmp(argv[i], "--force"))
+        {
+            session.incremental = false;
+        }
+        else if (!strcmp(argv[i], "--no-catalog-cache"))
+        {
+            cacheDir.clear();
+        }
+#ifdef SOUNDEXTRACT_PERF_COUNTERS
+        else if (!strcmp(argv[i], "--perf"))
+        {
+            perf = true;
+        }
+        else if (!strcmp(argv[i], "--perf-json") && i + 1 < argc)
+        {
+            perfJson = argv[++i];
+        }
+#endif
+        else if (argv[i][0] == '-')
+        {
+            Usage(argv[0]);
+            return 1;
+        }
+        else
+        {
+            inputs.push_back(argv[i]);
+        }
+    }
+    if (session.dirExport.empty() || inputs.empty())
+    {
+        Usage(argv[0]);
+        return 1;
+    }
+    if (session.jobs == 0)
+    {
+        session.jobs = 1;
+    }
+    //cores the workers leave idle go to decoding long ADPCM sounds
+    session.options.decodeThreads = std::max(1u, std::thread::hardware_concurrency() / session.jobs);
+
+    //directories are imported whole, non-SoundbanksInfo XMLs in them skipped
+    for (const auto &input : inputs)
+    {
+        std::error_code ec;
+        if (fs::is_directory(input, ec))
+        {
+            GameAudio game;
+            if (!ImportDirectory(input, game, cacheDir, session.jobs))
+            {
+                fprintf(stderr, "%s: cannot list directory\n", input.c_str());
+                continue;
+            }
+            session.sounds.insert(session.sounds.end(), std::make_move_iterator(game.sounds.begin()), std::make_move_iterator(game.sounds.end()));
+        }
+        else if (!LoadSoundbanksInfo(input, session.sounds, cacheDir))
+        {
+            fprintf(stderr, "%s: not a SoundbanksInfo file\n", input.c_str());
+        }
+    }
+    std::set<std::string> banks;
+    for (const auto &sound : session.sounds)
+    {
+        banks.insert(sound.bankPath);
+    }
+    //map every bank up front; workers only read the index after this
+    for (const auto &bank : banks)
+    {
+        if (!session.index.AddBank(bank))
+            fprintf(stderr, "%s: cannot open bank\n", bank.c_str());
+    }
+
+    std::mutex logMutex;
+    ExportJob job(session, [&logMutex](const Sound &sound, bool ok, const std::string &error)
+    {
+        if (!ok)
+        {
+            std::lock_guard<std::mutex> lock(logMutex);
+            fprintf(stderr, "failed: %s (%s): %s\n", sound.name.c_str(), sound.id.c_str(), error.c_str());
+        }
+    });
+    interruptible = &job;
+    signal(SIGINT, Interrupt);
+    job.Run();
+    signal(SIGINT, SIG_DFL);
+    interruptible = nullptr;
+
+    const ExportProgress &progress = job.Progress();
+    size_t total = session.sounds.size();
+    size_t done = progress.done;
+    size_t failed = progress.failed;
+    if (done < total)
+        fprintf(stderr, "interrupted after %zu of %zu sounds\n", done, total);
+    fprintf(stderr, "extracted %zu of %zu sounds from %zu banks (%zu up to date)\n", done - failed, total, banks.size(), size_t(progress.unchanged));
+#ifdef SOUNDEXTRACT_PERF_COUNTERS
+    if (!perfJson.empty())
+    {
+        FILE *out = perfJson == "-" ? stdout : fopen(perfJson.c_str(), "w");
+        if (out)
+        {
+            PerfReport(out, true);
+            if (out != stdout)
+                fclose(out);
+        }
+        else
+        {
+            fprintf(stderr, "%s: cannot write the perf report\n", perfJson.c_str());
+        }
+    }
+    else if (perf)
+    {
+        PerfReport(stderr, false);
+    }
+#endif
+    return failed || done < total ? 2 : 0;
+}
@@ -1,6 +1,6 @@
 #define __STDC_CONSTANT_MACROS
 #include "codebook.h"
-static unsigned char codebook[] = {
+static const unsigned char codebook[] = {
 	0x91,	0x0,	0x58,	0x53,	0x55,	0x75,	0x75,	0x0,	0x91,	0x1,
 	0x58,	0x0,	0x75,	0x75,	0x95,	0xb5,	0xb5,	0xb7,	0xd7,	0xd9,
 	0x0,	0x1,	0x4,	0x60,	0x0,	0x0,	0x0,	0x25,	0x8d,	0x54,
@@ -7442,28 +7442,24 @@ static unsigned char codebook[] = {
 	0x19,	0x1,	0x0,	0x37,	0x19,	0x1,	0x0, };
 static const size_t cb_len = 74387;
 
-codebook_library::codebook_library(void)
-    : codebook_data(nullptr), codebook_offsets(nullptr), codebook_count(0)
+#ifndef NO_PREBUILT_CODEBOOKS
+struct Rebuilt_codebook
 {
-	long pos = cb_len - 4;
-    long offset_offset = read_32_le(&codebook[pos]);
-    codebook_count = (cb_len - offset_offset) / 4;
+    uint32_t offset;    // into rebuilt_codebook_data, byte aligned
+    uint32_t bits;      // 0 if the packed codebook didn't rebuild
+};
 
-    codebook_data = new char [offset_offset];
-    codebook_offsets = new long [codebook_count];
+// rebuilt_codebook_data[], rebuilt_codebooks[] and rebuilt_codebook_count,
+// one entry per library codebook
+#include "codebook_rebuilt.inc"
+#endif
 
-	pos = 0;
-    for (long i = 0; i < offset_offset; i++)
-    {
-        codebook_data[i] = static_cast<char>(codebook[pos]);
-		pos++;
-    }
-
-    for (long i = 0; i < codebook_count; i++)
-    {
-        codebook_offsets[i] = read_32_le(&codebook[pos]);
-		pos += 4;
-    }
+codebook_library::codebook_library(void)
+    : codebook_data(reinterpret_cast<const char *>(codebook)), codebook_offsets(nullptr), codebook_count(0)
+{
+    long offset_offset = read_32_le(&codebook[cb_len - 4]);
+    codebook_count = (cb_len - offset_offset) / 4;
+    codebook_offsets = &codebook[offset_offset];
 }
 
 void codebook_library::rebuild(int i, Bit_oggstream& bos)
@@ -7479,9 +7475,16 @@ void codebook_library::rebuild(int i, Bit_oggstream& bos)
         cb_size = signed_cb_size;
     }
 
-    array_streambuf asb(cb, cb_size);
-    istream is(&asb);
-    Bit_stream bis(is);
+#ifndef NO_PREBUILT_CODEBOOKS
+    if (static_cast<unsigned int>(i) < rebuilt_codebook_count && rebuilt_codebooks[i].bits != 0)
+    {
+        bos.copy_bits(&rebuilt_codebook_data[rebuilt_codebooks[i].offset], rebuilt_codebooks[i].bits);
+        return;
+    }
+#endif
+
+    // reparse, which also reports why it doesn't rebuild
+    Bit_stream bis(reinterpret_cast<const unsigned char *>(cb), cb_size);
 
     rebuild(bis, cb_size, bos);
 }
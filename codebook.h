@@ -48,43 +48,33 @@ unsigned int _book_maptype1_quantvals(unsigned int entries, unsigned int dimensi
 
 class codebook_library
 {
-    char * codebook_data;
-    long * codebook_offsets;
+    // the embedded library is used in place, nothing is copied
+    const char * codebook_data;
+    const unsigned char * codebook_offsets;     // 32 bit little-endian
     long codebook_count;
 
-    // Intentionally undefined
-    codebook_library& operator=(const codebook_library& rhs) = delete;
-    codebook_library(const codebook_library& rhs) = delete;
+    long codebook_offset(int i) const
+    {
+        return static_cast<long>(read_32_le(&codebook_offsets[4 * i]));
+    }
 
 public:
     codebook_library(void);
 
-    ~codebook_library()
-    {
-        delete [] codebook_data;
-        delete [] codebook_offsets;
-    }
-
     const char * get_codebook(int i) const
     {
-        if (!codebook_data || !codebook_offsets)
-        {
-            throw Parse_error_str("codebook library not loaded");
-        }
         if (i >= codebook_count-1 || i < 0) return nullptr;
-        return &codebook_data[codebook_offsets[i]];
+        return &codebook_data[codebook_offset(i)];
     }
 
     long get_codebook_size(int i) const
     {
-        if (!codebook_data || !codebook_offsets)
-        {
-            throw Parse_error_str("codebook library not loaded");
-        }
         if (i >= codebook_count-1 || i < 0) return -1;
-        return codebook_offsets[i+1]-codebook_offsets[i];
+        return codebook_offset(i+1)-codebook_offset(i);
     }
 
+    // library codebooks come pre-expanded into Vorbis form (built by
+    // codebook-gen), so this is a bit copy unless that one failed to expand
     void rebuild(int i, Bit_oggstream& bos);
 
     void rebuild(Bit_stream &bis, unsigned long cb_size, Bit_oggstream& bos);
@@ -0,0 +1,86 @@
+/*
+soundextract
+Copyright 2018 Jonathan wilson
+Copyright 2020 Sławomir Śpiewak
+
+Soundextract is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version. See the file COPYING for more details.
+*/
+
+//build step: codebook-gen <output .inc>
+//expands every packed library codebook into its Vorbis bitstring once, so
+//codebook_library::rebuild(int) only has to copy bits at run time
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "codebook.h"
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s <output file>\n", argv[0]);
+        return 1;
+    }
+
+    codebook_library cbl;
+    std::vector<unsigned char> data;
+    std::vector<std::pair<size_t, unsigned long>> books;
+    for (int i = 0; cbl.get_codebook(i); i++)
+    {
+        std::ostringstream page;
+        unsigned long bits = 0;
+        {
+            Bit_oggstream os(page);
+            try
+            {
+                cbl.rebuild(i, os);
+                bits = os.get_total_bits_written();
+            }
+            catch (...)
+            {
+                //left to the parser at run time, which reports the error
+                bits = 0;
+            }
+            os.flush_page();
+        }
+        books.emplace_back(data.size(), bits);
+        if (bits)
+        {
+            //one page holding just this codebook, padded to a byte
+            std::string p = page.str();
+            size_t payload = 27 + static_cast<unsigned char>(p[26]);
+            data.insert(data.end(), p.begin() + payload, p.begin() + payload + (bits + 7) / 8);
+        }
+    }
+
+    FILE *out = fopen(argv[1], "w");
+    if (!out)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    fprintf(out, "// generated by codebook-gen from the packed library in codebook.cpp\n");
+    fprintf(out, "static const unsigned char rebuilt_codebook_data[] = {");
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        fprintf(out, "%s0x%02x,", i % 16 ? " " : "\n\t", data[i]);
+    }
+    fprintf(out, "\n\t0 };\n\n");
+    fprintf(out, "static const Rebuilt_codebook rebuilt_codebooks[] = {");
+    for (size_t i = 0; i < books.size(); i++)
+    {
+        fprintf(out, "%s{%zu, %lu},", i % 6 ? " " : "\n\t", books[i].first, books[i].second);
+    }
+    fprintf(out, "\n\t{0, 0} };\n\n");
+    fprintf(out, "static const unsigned int rebuilt_codebook_count = %zu;\n", books.size());
+    if (fclose(out) != 0)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    return 0;
+}
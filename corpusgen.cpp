@@ -0,0 +1,893 @@
+/*
+soundextract
+Copyright 2018 Jonathan wilson
+Copyright 2020 Sławomir Śpiewak
+
+Soundextract is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version. See the file COPYING for more details.
+*/
+
+//synthetic Wwise game audio for benchmarks: soundextract-corpusgen [options] <output dir>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <vorbis/vorbisenc.h>
+#include "Bit_stream.h"
+#include "codebook.h"
+
+namespace fs = std::filesystem;
+
+//how a Vorbis wem stores its packets, named after its vorb chunk size
+struct VorbLayout
+{
+    const char *name;
+    int vorbSize;           //-1: no vorb chunk, its fields sit at the end of a 0x42 fmt
+    bool modPackets;        //audio packets without the type bit and window flags
+};
+
+static const VorbLayout layouts[] = {
+    { "42", -1, false },
+    { "42mod", -1, true },
+    { "2a", 0x2A, false },
+    { "2amod", 0x2A, true },
+    { "28", 0x28, false },
+    { "2c", 0x2C, false },
+    { "32", 0x32, false },
+    { "34", 0x34, false },
+};
+
+//little-endian output buffer
+struct ByteWriter
+{
+    std::vector<unsigned char> bytes;
+
+    void U8(unsigned int v) { bytes.push_back(static_cast<unsigned char>(v)); }
+    void U16(unsigned int v) { U8(v & 0xFF); U8(v >> 8 & 0xFF); }
+    void U32(uint32_t v) { U16(v & 0xFFFF); U16(v >> 16); }
+    void Raw(const void *data, size_t size)
+    {
+        const unsigned char *p = static_cast<const unsigned char *>(data);
+        bytes.insert(bytes.end(), p, p + size);
+    }
+    void Tag(const char *tag) { Raw(tag, 4); }
+    void Patch32(size_t offset, uint32_t v)
+    {
+        for (int i = 0; i < 4; i++)
+            bytes[offset + i] = static_cast<unsigned char>(v >> (8 * i));
+    }
+};
+
+//LSB-first bit packer for the rewritten packets
+struct BitWriter
+{
+    std::vector<unsigned char> bytes;
+    size_t bits = 0;
+
+    void Put(uint32_t value, unsigned int count)
+    {
+        for (unsigned int i = 0; i < count; i++, bits++)
+        {
+            if ((bits & 7) == 0)
+                bytes.push_back(0);
+            if (value >> i & 1)
+                bytes.back() |= static_cast<unsigned char>(1 << (bits & 7));
+        }
+    }
+};
+
+//read count bits and write them straight back out
+static uint32_t Copy(Bit_stream &in, BitWriter &out, unsigned int count)
+{
+    uint32_t value = in.get_bits(count);
+    out.Put(value, count);
+    return value;
+}
+
+//one clip as libvorbis encoded it
+struct EncodedClip
+{
+    unsigned int channels;
+    unsigned int rate;
+    unsigned int blocksize0Pow, blocksize1Pow;
+    std::vector<unsigned char> headers[3];
+    std::vector<std::vector<unsigned char>> packets;
+    std::vector<uint32_t> granules;
+    uint32_t samples;
+};
+
+//a few tones per channel under low noise, the same for the same seed
+static EncodedClip EncodeClip(unsigned int channels, unsigned int rate, double seconds, uint32_t seed, float quality)
+{
+    EncodedClip clip;
+    clip.channels = channels;
+    clip.rate = rate;
+    vorbis_info vi;
+    vorbis_info_init(&vi);
+    if (vorbis_encode_init_vbr(&vi, channels, rate, quality) != 0)
+    {
+        vorbis_info_clear(&vi);
+        throw std::runtime_error("vorbisenc has no mode for " + std::to_string(channels) + " channels at " + std::to_string(rate) + " Hz");
+    }
+    vorbis_comment vc;
+    vorbis_comment_init(&vc);
+    vorbis_dsp_state vd;
+    vorbis_analysis_init(&vd, &vi);
+    vorbis_block vb;
+    vorbis_block_init(&vd, &vb);
+    ogg_packet headers[3];
+    vorbis_analysis_headerout(&vd, &vc, &headers[0], &headers[1], &headers[2]);
+    for (int i = 0; i < 3; i++)
+        clip.headers[i].assign(headers[i].packet, headers[i].packet + headers[i].bytes);
+    clip.blocksize0Pow = ilog(vorbis_info_blocksize(&vi, 0)) - 1;
+    clip.blocksize1Pow = ilog(vorbis_info_blocksize(&vi, 1)) - 1;
+
+    std::mt19937 rng(seed);
+    std::vector<float> pitch(channels);
+    for (auto &p : pitch)
+        p = 2 * 3.14159265f * (110 + rng() % 880) / rate;
+    long total = static_cast<long>(seconds * rate), written = 0;
+    int64_t granule = 0;
+    for (bool flushed = false; !flushed;)
+    {
+        if (written < total)
+        {
+            long frames = std::min(1024L, total - written);
+            float **buffer = vorbis_analysis_buffer(&vd, frames);
+            for (long i = 0; i < frames; i++)
+            {
+                for (unsigned int c = 0; c < channels; c++)
+                {
+                    float t = static_cast<float>(written + i);
+                    buffer[c][i] = 0.3f * sinf(t * pitch[c]) + 0.1f * sinf(t * pitch[c] * 1.5f) + (rng() % 2001 - 1000) / 50000.0f;
+                }
+            }
+            vorbis_analysis_wrote(&vd, frames);
+            written += frames;
+        }
+        else
+        {
+            vorbis_analysis_wrote(&vd, 0);
+            flushed = true;
+        }
+        while (vorbis_analysis_blockout(&vd, &vb) == 1)
+        {
+            vorbis_analysis(&vb, nullptr);
+            vorbis_bitrate_addblock(&vb);
+            ogg_packet op;
+            while (vorbis_bitrate_flushpacket(&vd, &op))
+            {
+                if (op.granulepos >= 0)
+                    granule = op.granulepos;
+                clip.packets.emplace_back(op.packet, op.packet + op.bytes);
+                clip.granules.push_back(static_cast<uint32_t>(granule));
+            }
+        }
+    }
+    clip.samples = static_cast<uint32_t>(granule);
+    vorbis_block_clear(&vb);
+    vorbis_dsp_clear(&vd);
+    vorbis_comment_clear(&vc);
+    vorbis_info_clear(&vi);
+    return clip;
+}
+
+//the built-in codebook library, keyed by each codebook's Vorbis bits
+class CodebookIds
+{
+    std::unordered_map<std::string, int> ids;
+
+    static std::string Key(const std::vector<unsigned char> &bytes, size_t bits)
+    {
+        return std::to_string(bits) + ":" + std::string(bytes.begin(), bytes.end());
+    }
+
+    class Capture : public Ogg_packet_sink
+    {
+    public:
+        std::vector<unsigned char> bytes;
+        void packet(const unsigned char *data, unsigned int size, uint32_t, bool, bool) override
+        {
+            bytes.assign(data, data + size);
+        }
+    };
+
+public:
+    CodebookIds()
+    {
+        codebook_library library;
+        for (int i = 0; library.get_codebook(i); i++)
+        {
+            Capture capture;
+            Bit_oggstream os(capture);
+            library.rebuild(i, os);
+            size_t bits = os.get_total_bits_written();
+            os.flush_page();
+            ids.emplace(Key(capture.bytes, bits), i);
+        }
+    }
+
+    //-1 if the library doesn't have it
+    int Find(const std::vector<unsigned char> &packet, size_t firstBit, size_t bits) const
+    {
+        BitWriter codebook;
+        for (size_t i = firstBit; i < firstBit + bits; i++)
+            codebook.Put(packet[i >> 3] >> (i & 7) & 1, 1);
+        auto it = ids.find(Key(codebook.bytes, bits));
+        return it == ids.end() ? -1 : it->second;
+    }
+};
+
+//a setup packet as Wwise stores it: library codebook ids and none of the
+//fields Wwise always leaves at one value
+struct WwiseSetup
+{
+    std::vector<unsigned char> packet;
+    std::vector<bool> blockflag;
+    unsigned int modeBits;
+};
+
+static WwiseSetup StripSetup(const std::vector<unsigned char> &setup, unsigned int channels, const CodebookIds &codebooks)
+{
+    WwiseSetup out;
+    Bit_stream in(setup.data(), setup.size());
+    BitWriter w;
+    in.get_bits(8);             //packet type
+    in.get_bits(24);            //"vorbis"
+    in.get_bits(24);
+
+    unsigned int codebookCount = Copy(in, w, 8) + 1;
+    for (unsigned int i = 0; i < codebookCount; i++)
+    {
+        size_t start = in.get_total_bits_read();
+        in.get_bits(24);
+        unsigned int dimensions = in.get_bits(16), entries = in.get_bits(24);
+        if (in.get_bits(1))
+        {
+            in.get_bits(5);
+            for (unsigned int current = 0; current < entries;)
+                current += in.get_bits(ilog(entries - current));
+        }
+        else
+        {
+            bool sparse = in.get_bits(1);
+            for (unsigned int e = 0; e < entries; e++)
+            {
+                if (!sparse || in.get_bits(1))
+                    in.get_bits(5);
+            }
+        }
+        unsigned int lookupType = in.get_bits(4);
+        if (lookupType)
+        {
+            in.get_bits(32);
+            in.get_bits(32);
+            unsigned int valueBits = in.get_bits(4) + 1;
+            in.get_bits(1);
+            unsigned int values = lookupType == 1 ? _book_maptype1_quantvals(entries, dimensions) : entries * dimensions;
+            for (unsigned int v = 0; v < values; v++)
+                in.get_bits(valueBits);
+        }
+        int id = codebooks.Find(setup, start, in.get_total_bits_read() - start);
+        if (id < 0)
+            throw std::runtime_error("vorbisenc used a codebook the Wwise library lacks; try another rate or quality");
+        w.Put(id, 10);
+    }
+
+    unsigned int timeCount = in.get_bits(6) + 1;
+    for (unsigned int i = 0; i < timeCount; i++)
+        in.get_bits(16);
+
+    unsigned int floorCount = Copy(in, w, 6) + 1;
+    for (unsigned int i = 0; i < floorCount; i++)
+    {
+        if (in.get_bits(16) != 1)
+            throw std::runtime_error("Wwise only stores floor type 1");
+        unsigned int partitions = Copy(in, w, 5);
+        std::vector<unsigned int> partitionClass(partitions);
+        unsigned int maxClass = 0;
+        for (auto &c : partitionClass)
+        {
+            c = Copy(in, w, 4);
+            maxClass = std::max(maxClass, c);
+        }
+        std::vector<unsigned int> classDimensions(maxClass + 1);
+        for (unsigned int c = 0; c <= maxClass; c++)
+        {
+            classDimensions[c] = Copy(in, w, 3) + 1;
+            unsigned int subclasses = Copy(in, w, 2);
+            if (subclasses)
+                Copy(in, w, 8);
+            for (unsigned int k = 0; k < (1U << subclasses); k++)
+                Copy(in, w, 8);
+        }
+        Copy(in, w, 2);
+        unsigned int rangeBits = Copy(in, w, 4);
+        for (unsigned int c : partitionClass)
+        {
+            for (unsigned int k = 0; k < classDimensions[c]; k++)
+                Copy(in, w, rangeBits);
+        }
+    }
+
+    unsigned int residueCount = Copy(in, w, 6) + 1;
+    for (unsigned int i = 0; i < residueCount; i++)
+    {
+        w.Put(in.get_bits(16), 2);
+        Copy(in, w, 24);
+        Copy(in, w, 24);
+        Copy(in, w, 24);
+        unsigned int classifications = Copy(in, w, 6) + 1;
+        Copy(in, w, 8);
+        std::vector<unsigned int> cascade(classifications);
+        for (auto &c : cascade)
+        {
+            unsigned int low = Copy(in, w, 3);
+            unsigned int high = Copy(in, w, 1) ? Copy(in, w, 5) : 0;
+            c = high * 8 + low;
+        }
+        for (unsigned int c : cascade)
+        {
+            for (int k = 0; k < 8; k++)
+            {
+                if (c & (1 << k))
+                    Copy(in, w, 8);
+            }
+        }
+    }
+
+    unsigned int mappingCount = Copy(in, w, 6) + 1;
+    for (unsigned int i = 0; i < mappingCount; i++)
+    {
+        in.get_bits(16);
+        unsigned int submaps = Copy(in, w, 1) ? Copy(in, w, 4) + 1 : 1;
+        if (Copy(in, w, 1))
+        {
+            unsigned int steps = Copy(in, w, 8) + 1;
+            for (unsigned int s = 0; s < steps; s++)
+            {
+                Copy(in, w, ilog(channels - 1));
+                Copy(in, w, ilog(channels - 1));
+            }
+        }
+        Copy(in, w, 2);
+        if (submaps > 1)
+        {
+            for (unsigned int c = 0; c < channels; c++)
+                Copy(in, w, 4);
+        }
+        for (unsigned int s = 0; s < submaps; s++)
+        {
+            Copy(in, w, 8);
+            Copy(in, w, 8);
+            Copy(in, w, 8);
+        }
+    }
+
+    unsigned int modeCount = Copy(in, w, 6) + 1;
+    for (unsigned int i = 0; i < modeCount; i++)
+    {
+        out.blockflag.push_back(Copy(in, w, 1) != 0);
+        in.get_bits(16);
+        in.get_bits(16);
+        Copy(in, w, 8);
+    }
+    out.modeBits = ilog(modeCount - 1);
+    out.packet = std::move(w.bytes);
+    return out;
+}
+
+//an audio packet without its type bit, and without the window flags of a long block
+static std::vector<unsigned char> ModPacket(const std::vector<unsigned char> &packet, const WwiseSetup &setup)
+{
+    Bit_stream in(packet.data(), packet.size());
+    BitWriter w;
+    in.get_bits(1);
+    unsigned int mode = Copy(in, w, setup.modeBits);
+    if (setup.blockflag[mode])
+        in.get_bits(2);
+    for (size_t left = packet.size() * 8 - in.get_total_bits_read(); left;)
+    {
+        unsigned int n = static_cast<unsigned int>(std::min<size_t>(left, 32));
+        Copy(in, w, n);
+        left -= n;
+    }
+    return w.bytes;
+}
+
+static uint32_t ChannelMask(unsigned int channels)
+{
+    static const uint32_t masks[] = { 0, 0x4, 0x3, 0x7, 0x33, 0x37, 0x3F, 0x13F, 0x63F };
+    return channels < sizeof(masks) / sizeof(masks[0]) ? masks[channels] : 0;
+}
+
+//RIFF WAVE around a fmt chunk and whatever chunks follow it
+static std::vector<unsigned char> Riff(const ByteWriter &fmt, const ByteWriter &chunks)
+{
+    ByteWriter w;
+    w.Tag("RIFF");
+    w.U32(static_cast<uint32_t>(4 + 8 + fmt.bytes.size() + chunks.bytes.size()));
+    w.Tag("WAVE");
+    w.Tag("fmt ");
+    w.U32(static_cast<uint32_t>(fmt.bytes.size()));
+    w.Raw(fmt.bytes.data(), fmt.bytes.size());
+    w.Raw(chunks.bytes.data(), chunks.bytes.size());
+    return w.bytes;
+}
+
+static std::vector<unsigned char> VorbisWem(const EncodedClip &clip, const WwiseSetup &setup, const VorbLayout &layout)
+{
+    bool triad = layout.vorbSize == 0x28 || layout.vorbSize == 0x2C;
+    bool noGranule = layout.vorbSize == -1 || layout.vorbSize == 0x2A;
+
+    //packet headers: 8 bytes before a header triad, 2 without granules, 6 otherwise
+    ByteWriter data;
+    auto packet = [&](const std::vector<unsigned char> &bytes, uint32_t granule)
+    {
+        if (triad)
+        {
+            data.U32(static_cast<uint32_t>(bytes.size()));
+            data.U32(granule);
+        }
+        else
+        {
+            data.U16(static_cast<unsigned int>(bytes.size()));
+            if (!noGranule)
+                data.U32(granule);
+        }
+        data.Raw(bytes.data(), bytes.size());
+    };
+    if (triad)
+    {
+        for (const auto &header : clip.headers)
+            packet(header, 0);
+    }
+    else
+    {
+        packet(setup.packet, 0);
+    }
+    uint32_t firstAudio = static_cast<uint32_t>(data.bytes.size());
+    for (size_t i = 0; i < clip.packets.size(); i++)
+        packet(layout.modPackets ? ModPacket(clip.packets[i], setup) : clip.packets[i], clip.granules[i]);
+
+    ByteWriter vorb;
+    vorb.bytes.assign(layout.vorbSize == -1 ? 0x2A : layout.vorbSize, 0);
+    vorb.Patch32(0x00, clip.samples);
+    if (noGranule)
+    {
+        vorb.Patch32(0x04, layout.modPackets ? 0xD9 : 0x4A);
+        vorb.Patch32(0x10, 0);
+        vorb.Patch32(0x14, firstAudio);
+        vorb.Patch32(0x24, 0x5E1F5E1F);
+        vorb.bytes[0x28] = static_cast<unsigned char>(clip.blocksize0Pow);
+        vorb.bytes[0x29] = static_cast<unsigned char>(clip.blocksize1Pow);
+    }
+    else
+    {
+        vorb.Patch32(0x18, 0);
+        vorb.Patch32(0x1C, firstAudio);
+        if (!triad)
+        {
+            vorb.Patch32(0x2C, 0x5E1F5E1F);
+            vorb.bytes[0x30] = static_cast<unsigned char>(clip.blocksize0Pow);
+            vorb.bytes[0x31] = static_cast<unsigned char>(clip.blocksize1Pow);
+        }
+    }
+
+    ByteWriter fmt, chunks;
+    fmt.U16(0xFFFF);
+    fmt.U16(clip.channels);
+    fmt.U32(clip.rate);
+    fmt.U32(clip.rate * clip.channels / 4);
+    fmt.U16(0);
+    fmt.U16(0);
+    fmt.U16(layout.vorbSize == -1 ? 0x42 - 0x12 : 0x18 - 0x12);
+    fmt.U16(0);
+    fmt.U32(ChannelMask(clip.channels));
+    if (layout.vorbSize == -1)
+    {
+        fmt.Raw(vorb.bytes.data(), vorb.bytes.size());
+    }
+    else
+    {
+        chunks.Tag("vorb");
+        chunks.U32(static_cast<uint32_t>(vorb.bytes.size()));
+        chunks.Raw(vorb.bytes.data(), vorb.bytes.size());
+    }
+    chunks.Tag("data");
+    chunks.U32(static_cast<uint32_t>(data.bytes.size()));
+    chunks.Raw(data.bytes.data(), data.bytes.size());
+    return Riff(fmt, chunks);
+}
+
+//the WAVEFORMATEXTENSIBLE-sized fmt ADPCM and PCM wems carry
+static ByteWriter PlainFormat(unsigned int tag, unsigned int channels, unsigned int rate, unsigned int blockAlign, unsigned int bits, unsigned int samplesPerBlock)
+{
+    ByteWriter fmt;
+    fmt.U16(tag);
+    fmt.U16(channels);
+    fmt.U32(rate);
+    fmt.U32(rate * blockAlign / std::max(1u, samplesPerBlock));
+    fmt.U16(blockAlign);
+    fmt.U16(bits);
+    fmt.U16(6);
+    fmt.U16(samplesPerBlock);
+    fmt.U32(ChannelMask(channels));
+    return fmt;
+}
+
+//Wwise IMA ADPCM: 36 bytes, 64 samples, per channel per block
+static std::vector<unsigned char> AdpcmWem(unsigned int channels, unsigned int rate, double seconds, std::mt19937 &rng)
+{
+    const unsigned int channelBytes = 36;
+    size_t blocks = std::max<size_t>(1, static_cast<size_t>(seconds * rate / 64));
+    ByteWriter chunks;
+    chunks.Tag("data");
+    chunks.U32(static_cast<uint32_t>(blocks * channels * channelBytes));
+    for (size_t b = 0; b < blocks * channels; b++)
+    {
+        chunks.U16(rng() & 0xFFFF);
+        chunks.U8(rng() % 89);
+        chunks.U8(0);
+        for (unsigned int i = 4; i < channelBytes; i++)
+            chunks.U8(rng() & 0xFF);
+    }
+    return Riff(PlainFormat(2, channels, rate, channelBytes * channels, 4, 64), chunks);
+}
+
+//16 bit PCM tones
+static std::vector<unsigned char> PcmWem(unsigned int channels, unsigned int rate, double seconds, std::mt19937 &rng)
+{
+    size_t frames = std::max<size_t>(1, static_cast<size_t>(seconds * rate));
+    float pitch = 2 * 3.14159265f * (110 + rng() % 880) / rate;
+    ByteWriter chunks;
+    chunks.Tag("data");
+    chunks.U32(static_cast<uint32_t>(frames * channels * 2));
+    for (size_t i = 0; i < frames; i++)
+    {
+        for (unsigned int c = 0; c < channels; c++)
+            chunks.U16(static_cast<uint16_t>(static_cast<int16_t>(8000 * sinf(i * pitch * (c + 1)))));
+    }
+    return Riff(PlainFormat(0xFFFE, channels, rate, 2 * channels, 16, 1), chunks);
+}
+
+static bool WriteFile(const fs::path &fileName, const std::vector<unsigned char> &data)
+{
+    FILE *f = fopen(fileName.string().c_str(), "wb");
+    if (!f)
+    {
+        fprintf(stderr, "%s: cannot write\n", fileName.string().c_str());
+        return false;
+    }
+    size_t written = fwrite(data.data(), 1, data.size(), f);
+    return fclose(f) == 0 && written == data.size();
+}
+
+static bool WriteFile(const fs::path &fileName, const std::string &text)
+{
+    return WriteFile(fileName, std::vector<unsigned char>(text.begin(), text.end()));
+}
+
+//a .bnk holding the given wems: BKHD, then DIDX pointing into a 16 byte aligned DATA
+static std::vector<unsigned char> Bank(uint32_t bankId, const std::vector<std::pair<uint32_t, std::vector<unsigned char>>> &media)
+{
+    ByteWriter didx, data;
+    for (const auto &m : media)
+    {
+        while (data.bytes.size() % 16)
+            data.U8(0);
+        didx.U32(m.first);
+        didx.U32(static_cast<uint32_t>(data.bytes.size()));
+        didx.U32(static_cast<uint32_t>(m.second.size()));
+        data.Raw(m.second.data(), m.second.size());
+    }
+    ByteWriter bank;
+    bank.Tag("BKHD");
+    bank.U32(24);
+    bank.U32(0x71);             //bank generator version
+    bank.U32(bankId);
+    bank.U32(0);                //language
+    bank.U16(0);
+    bank.U16(0);
+    bank.U32(0);                //project
+    bank.U32(0);
+    if (!media.empty())
+    {
+        bank.Tag("DIDX");
+        bank.U32(static_cast<uint32_t>(didx.bytes.size()));
+        bank.Raw(didx.bytes.data(), didx.bytes.size());
+        bank.Tag("DATA");
+        bank.U32(static_cast<uint32_t>(data.bytes.size()));
+        bank.Raw(data.bytes.data(), data.bytes.size());
+    }
+    return bank.bytes;
+}
+
+struct Options
+{
+    unsigned int banks = 8;
+    unsigned int sounds = 64;           //per bank
+    uint64_t sizeLimit = 0;             //bytes; more banks until the corpus is this big
+    std::vector<unsigned int> channels = { 1, 2 };
+    unsigned int rate = 48000;
+    double minSeconds = 1, maxSeconds = 4;
+    float quality = 0.4f;
+    unsigned int clips = 4;             //distinct encodes per channel count
+    unsigned int streamedPercent = 50;
+    unsigned int vorbisWeight = 6, adpcmWeight = 1, pcmWeight = 1;
+    std::vector<const VorbLayout *> bankLayouts;
+    uint32_t seed = 1;
+};
+
+static std::vector<std::string> Split(const std::string &list, char separator)
+{
+    std::vector<std::string> parts;
+    std::stringstream ss(list);
+    for (std::string part; std::getline(ss, part, separator);)
+        parts.push_back(part);
+    return parts;
+}
+
+static const VorbLayout *FindLayout(const std::string &name)
+{
+    for (const auto &layout : layouts)
+    {
+        if (name == layout.name)
+            return &layout;
+    }
+    return nullptr;
+}
+
+static void Usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [options] <output dir>\n", argv0);
+    fprintf(stderr, "  --banks N        banks to write (default: 8)\n");
+    fprintf(stderr, "  --sounds N       sounds per bank (default: 64)\n");
+    fprintf(stderr, "  --size MB        keep adding banks until the corpus is this big, overrides --banks\n");
+    fprintf(stderr, "  --channels L     channel counts to draw from, e.g. 1,2,6 (default: 1,2)\n");
+    fprintf(stderr, "  --rate HZ        sample rate (default: 48000)\n");
+    fprintf(stderr, "  --seconds A[,B]  sound length, or a range to draw from (default: 1,4)\n");
+    fprintf(stderr, "  --quality Q      vorbisenc VBR quality, -0.1 to 1 (default: 0.4)\n");
+    fprintf(stderr, "  --clips N        distinct Vorbis encodes per channel count (default: 4)\n");
+    fprintf(stderr, "  --streamed PCT   share of sounds written as streamed .wem files (default: 50)\n");
+    fprintf(stderr, "  --mix V,A,P      weights of Vorbis, ADPCM and PCM sounds (default: 6,1,1)\n");
+    fprintf(stderr, "  --layouts L      Vorbis layouts for bank sounds, from 42,42mod,2a,2amod,28,2c,32,34\n");
+    fprintf(stderr, "                   or all (default: all)\n");
+    fprintf(stderr, "  --seed N         same seed and options, same bytes (default: 1)\n");
+    fprintf(stderr, "every layout is also written once per channel count under layouts/\n");
+}
+
+static bool ParseOptions(int argc, char *argv[], Options &options, std::string &outDir)
+{
+    std::string layoutList = "all";
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg[0] != '-')
+        {
+            if (!outDir.empty())
+                return false;
+            outDir = arg;
+            continue;
+        }
+        if (i + 1 >= argc)
+            return false;
+        std::string value = argv[++i];
+        if (arg == "--banks")
+            options.banks = std::max(1, atoi(value.c_str()));
+        else if (arg == "--sounds")
+            options.sounds = std::max(1, atoi(value.c_str()));
+        else if (arg == "--size")
+            options.sizeLimit = static_cast<uint64_t>(atof(value.c_str()) * 1048576);
+        else if (arg == "--channels")
+        {
+            options.channels.clear();
+            for (const auto &c : Split(value, ','))
+            {
+                int channels = atoi(c.c_str());
+                if (channels < 1 || channels > 8)
+                    return false;
+                options.channels.push_back(channels);
+            }
+        }
+        else if (arg == "--rate")
+            options.rate = atoi(value.c_str());
+        else if (arg == "--seconds")
+        {
+            auto range = Split(value, ',');
+            options.minSeconds = atof(range[0].c_str());
+            options.maxSeconds = range.size() > 1 ? atof(range[1].c_str()) : options.minSeconds;
+            if (options.minSeconds <= 0 || options.maxSeconds < options.minSeconds)
+                return false;
+        }
+        else if (arg == "--quality")
+            options.quality = static_cast<float>(atof(value.c_str()));
+        else if (arg == "--clips")
+            options.clips = std::max(1, atoi(value.c_str()));
+        else if (arg == "--streamed")
+            options.streamedPercent = std::min(100, std::max(0, atoi(value.c_str())));
+        else if (arg == "--mix")
+        {
+            auto weights = Split(value, ',');
+            if (weights.size() != 3)
+                return false;
+            options.vorbisWeight = atoi(weights[0].c_str());
+            options.adpcmWeight = atoi(weights[1].c_str());
+            options.pcmWeight = atoi(weights[2].c_str());
+            if (options.vorbisWeight + options.adpcmWeight + options.pcmWeight == 0)
+                return false;
+        }
+        else if (arg == "--layouts")
+            layoutList = value;
+        else if (arg == "--seed")
+            options.seed = static_cast<uint32_t>(strtoul(value.c_str(), nullptr, 10));
+        else
+            return false;
+    }
+    for (const auto &name : Split(layoutList, ','))
+    {
+        if (name == "all")
+        {
+            for (const auto &layout : layouts)
+                options.bankLayouts.push_back(&layout);
+        }
+        else if (const VorbLayout *layout = FindLayout(name))
+            options.bankLayouts.push_back(layout);
+        else
+            return false;
+    }
+    return !outDir.empty() && !options.bankLayouts.empty() && options.rate > 0;
+}
+
+//a clip ready to pack: the encode and its Wwise setup
+struct Clip
+{
+    EncodedClip encoded;
+    WwiseSetup setup;
+};
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    std::string outDir;
+    if (!ParseOptions(argc, argv, options, outDir))
+    {
+        Usage(argv[0]);
+        return 1;
+    }
+    std::error_code ec;
+    fs::create_directories(fs::path(outDir) / "layouts", ec);
+    if (ec)
+    {
+        fprintf(stderr, "%s: %s\n", outDir.c_str(), ec.message().c_str());
+        return 1;
+    }
+
+    //encoding is the slow part, so a few clips per channel count are packed over and over
+    std::mt19937 rng(options.seed);
+    std::uniform_real_distribution<double> seconds(options.minSeconds, options.maxSeconds);
+    CodebookIds codebooks;
+    std::vector<std::vector<Clip>> clips;
+    try
+    {
+        for (unsigned int channels : options.channels)
+        {
+            clips.emplace_back();
+            for (unsigned int i = 0; i < options.clips; i++)
+            {
+                Clip clip;
+                clip.encoded = EncodeClip(channels, options.rate, seconds(rng), rng(), options.quality);
+                clip.setup = StripSetup(clip.encoded.headers[2], channels, codebooks);
+                clips.back().push_back(std::move(clip));
+            }
+        }
+    }
+    catch (const std::exception &e)
+    {
+        //5.1 at 44.1 and 48 kHz is one: vorbisenc's LFE books aren't in the library
+        fprintf(stderr, "%u channels at %u Hz: %s\n", options.channels[clips.size() - 1], options.rate, e.what());
+        return 1;
+    }
+    catch (...)
+    {
+        fprintf(stderr, "cannot parse vorbisenc's setup packet\n");
+        return 1;
+    }
+
+    for (size_t c = 0; c < options.channels.size(); c++)
+    {
+        for (const auto &layout : layouts)
+        {
+            std::string name = std::string("vorbis_") + layout.name + "_" + std::to_string(options.channels[c]) + "ch.wem";
+            if (!WriteFile(fs::path(outDir) / "layouts" / name, VorbisWem(clips[c][0].encoded, clips[c][0].setup, layout)))
+                return 1;
+        }
+    }
+
+    uint64_t totalBytes = 0;
+    size_t totalSounds = 0, streamedSounds = 0;
+    uint32_t mediaId = 100000;
+    unsigned int totalWeight = options.vorbisWeight + options.adpcmWeight + options.pcmWeight;
+    unsigned int bankCount = 0;
+    for (; options.sizeLimit ? totalBytes < options.sizeLimit : bankCount < options.banks; bankCount++)
+    {
+        char bankName[32];
+        snprintf(bankName, sizeof(bankName), "Bank%04u", bankCount);
+        std::ostringstream streamedXml, memoryXml;
+        std::vector<std::pair<uint32_t, std::vector<unsigned char>>> media;
+        for (unsigned int s = 0; s < options.sounds; s++)
+        {
+            size_t c = rng() % options.channels.size();
+            unsigned int channels = options.channels[c];
+            unsigned int kind = rng() % totalWeight;
+            std::vector<unsigned char> wem;
+            if (kind < options.vorbisWeight)
+            {
+                const Clip &clip = clips[c][rng() % clips[c].size()];
+                const VorbLayout &layout = *options.bankLayouts[rng() % options.bankLayouts.size()];
+                wem = VorbisWem(clip.encoded, clip.setup, layout);
+            }
+            else if (kind < options.vorbisWeight + options.adpcmWeight)
+            {
+                wem = AdpcmWem(channels, options.rate, seconds(rng), rng);
+            }
+            else
+            {
+                wem = PcmWem(channels, options.rate, seconds(rng), rng);
+            }
+
+            uint32_t id = mediaId++;
+            char soundName[64];
+            snprintf(soundName, sizeof(soundName), "%s_%05u", bankName, s);
+            bool streamed = rng() % 100 < options.streamedPercent;
+            std::ostringstream &xml = streamed ? streamedXml : memoryXml;
+            xml << "\t\t\t\t<File Id=\"" << id << "\" Language=\"SFX\">\n"
+                << "\t\t\t\t\t<ShortName>" << soundName << ".wav</ShortName>\n"
+                << "\t\t\t\t\t<Path>SFX\\" << soundName << ".wem</Path>\n"
+                << "\t\t\t\t</File>\n";
+            totalBytes += wem.size();
+            totalSounds++;
+            if (streamed)
+            {
+                streamedSounds++;
+                if (!WriteFile(fs::path(outDir) / (std::to_string(id) + ".wem"), wem))
+                    return 1;
+            }
+            else
+            {
+                media.emplace_back(id, std::move(wem));
+            }
+        }
+
+        std::ostringstream xml;
+        xml << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+            << "<SoundBanksInfo Platform=\"Windows\" SchemaVersion=\"11\" SoundbankVersion=\"113\">\n"
+            << "\t<SoundBanks>\n"
+            << "\t\t<SoundBank Id=\"" << bankCount + 1 << "\" Language=\"SFX\">\n"
+            << "\t\t\t<ShortName>" << bankName << "</ShortName>\n"
+            << "\t\t\t<Path>" << bankName << ".bnk</Path>\n";
+        if (!streamedXml.str().empty())
+            xml << "\t\t\t<ReferencedStreamedFiles>\n" << streamedXml.str() << "\t\t\t</ReferencedStreamedFiles>\n";
+        if (!memoryXml.str().empty())
+            xml << "\t\t\t<IncludedMemoryFiles>\n" << memoryXml.str() << "\t\t\t</IncludedMemoryFiles>\n";
+        xml << "\t\t</SoundBank>\n"
+            << "\t</SoundBanks>\n"
+            << "</SoundBanksInfo>\n";
+        if (!WriteFile(fs::path(outDir) / (std::string(bankName) + ".xml"), xml.str()) ||
+            !WriteFile(fs::path(outDir) / (std::string(bankName) + ".bnk"), Bank(bankCount + 1, media)))
+            return 1;
+    }
+
+    printf("%u banks, %zu sounds (%zu streamed), %.1f MB of wems in %s\n", bankCount, totalSounds, streamedSounds, totalBytes / 1048576.0, outDir.c_str());
+    return 0;
+}
@@ -1,6 +1,18 @@
 #include <stdint.h>
+#include <string.h>
 #include "crc.h"
 
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    #define CRC_PCLMUL
+    #include <immintrin.h>
+#endif
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__aarch64__) && defined(__linux__)
+    #define CRC_ARMV8
+    #include <arm_acle.h>
+    #include <sys/auxv.h>
+    #include <asm/hwcap.h>
+#endif
+
 /* from Tremor (lowmem) */
 static uint32_t crc_lookup[256]={
   0x00000000,0x04c11db7,0x09823b6e,0x0d4326d9,
@@ -68,11 +80,146 @@ static uint32_t crc_lookup[256]={
   0xafb010b1,0xab710d06,0xa6322bdf,0xa2f33668,
   0xbcb4666d,0xb8757bda,0xb5365d03,0xb1f740b4};
 
-uint32_t checksum(unsigned char *data, int bytes){
+uint32_t checksum_bytewise(const unsigned char *data, size_t bytes){
   uint32_t crc_reg=0;
 
-	for(int i = 0;i<bytes;++i)
+  for(size_t i = 0;i<bytes;++i)
+      crc_reg=(crc_reg<<8)^crc_lookup[((crc_reg >> 24)&0xff)^data[i]];
+
+  return crc_reg;
+}
+
+static uint32_t crc_update(uint32_t crc_reg, const unsigned char *data, size_t bytes){
+  for(size_t i = 0;i<bytes;++i)
       crc_reg=(crc_reg<<8)^crc_lookup[((crc_reg >> 24)&0xff)^data[i]];
 
   return crc_reg;
 }
+
+/* crc_slice[k][b] is the CRC of byte b followed by k zero bytes */
+struct Slicing_tables
+{
+  uint32_t t[8][256];
+
+  Slicing_tables(){
+    for(int b = 0;b<256;++b)
+      t[0][b]=crc_lookup[b];
+    for(int k = 1;k<8;++k)
+      for(int b = 0;b<256;++b)
+        t[k][b]=(t[k-1][b]<<8)^crc_lookup[t[k-1][b]>>24];
+  }
+};
+
+static const Slicing_tables crc_slice;
+
+static uint32_t slicing_update(uint32_t crc_reg, const unsigned char *data, size_t bytes){
+  const uint32_t (*t)[256]=crc_slice.t;
+
+  for(;bytes>=8;data+=8,bytes-=8){
+    uint32_t hi=crc_reg^((uint32_t)data[0]<<24|(uint32_t)data[1]<<16|(uint32_t)data[2]<<8|data[3]);
+    crc_reg=t[7][hi>>24]^t[6][(hi>>16)&0xff]^t[5][(hi>>8)&0xff]^t[4][hi&0xff]^
+      t[3][data[4]]^t[2][data[5]]^t[1][data[6]]^t[0][data[7]];
+  }
+
+  return crc_update(crc_reg,data,bytes);
+}
+
+uint32_t checksum_slicing(const unsigned char *data, size_t bytes){
+  return slicing_update(0,data,bytes);
+}
+
+#ifdef CRC_PCLMUL
+/* x^n mod P, P = x^32 + 0x04c11db7 */
+static uint64_t xpow_mod(unsigned int n){
+  uint64_t r=1;
+  for(unsigned int i = 0;i<n;++i){
+    r<<=1;
+    if(r&0x100000000ULL) r^=0x104c11db7ULL;
+  }
+  return r;
+}
+
+/* 16 message bytes as one 128 bit polynomial, first byte on top */
+__attribute__((target("pclmul,ssse3")))
+static inline __m128i load_poly(const unsigned char *p){
+  const __m128i swap=_mm_set_epi8(0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15);
+  return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)p),swap);
+}
+
+/* x * x^(128*n) as two 64x32 products, k = (x^(128*n+64), x^(128*n)) mod P */
+__attribute__((target("pclmul,ssse3")))
+static inline __m128i fold(__m128i x, __m128i k){
+  return _mm_xor_si128(_mm_clmulepi64_si128(x,k,0x11),_mm_clmulepi64_si128(x,k,0x00));
+}
+
+/* Folds 64 bytes per round into four accumulators, then one 128 bit value
+   congruent to the whole prefix; its CRC equals the prefix's. */
+__attribute__((target("pclmul,ssse3")))
+static uint32_t pclmul_checksum(const unsigned char *data, size_t bytes){
+  static const __m128i k512=_mm_set_epi64x((long long)xpow_mod(576),(long long)xpow_mod(512));
+  static const __m128i k128=_mm_set_epi64x((long long)xpow_mod(192),(long long)xpow_mod(128));
+
+  if(bytes<64) return slicing_update(0,data,bytes);
+
+  __m128i x0=load_poly(data),x1=load_poly(data+16),x2=load_poly(data+32),x3=load_poly(data+48);
+  data+=64;
+  bytes-=64;
+  for(;bytes>=64;data+=64,bytes-=64){
+    x0=_mm_xor_si128(fold(x0,k512),load_poly(data));
+    x1=_mm_xor_si128(fold(x1,k512),load_poly(data+16));
+    x2=_mm_xor_si128(fold(x2,k512),load_poly(data+32));
+    x3=_mm_xor_si128(fold(x3,k512),load_poly(data+48));
+  }
+  x1=_mm_xor_si128(fold(x0,k128),x1);
+  x2=_mm_xor_si128(fold(x1,k128),x2);
+  x3=_mm_xor_si128(fold(x2,k128),x3);
+  for(;bytes>=16;data+=16,bytes-=16)
+    x3=_mm_xor_si128(fold(x3,k128),load_poly(data));
+
+  const __m128i swap=_mm_set_epi8(0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15);
+  unsigned char folded[16];
+  _mm_storeu_si128((__m128i *)folded,_mm_shuffle_epi8(x3,swap));
+
+  return slicing_update(slicing_update(0,folded,16),data,bytes);
+}
+#endif
+
+#ifdef CRC_ARMV8
+/* The CRC32 instructions compute the bit-reflected CRC over the same
+   polynomial: feed them bit-reversed bytes and reverse the result. */
+__attribute__((target("+crc")))
+static uint32_t armv8_checksum(const unsigned char *data, size_t bytes){
+  uint32_t crc_reg=0;
+
+  for(;bytes>=8;data+=8,bytes-=8){
+    uint64_t w;
+    memcpy(&w,data,8);
+    crc_reg=__crc32d(crc_reg,__builtin_bswap64(__rbitll(w)));
+  }
+  for(;bytes>0;++data,--bytes)
+    crc_reg=__crc32b(crc_reg,(uint8_t)(__rbit((uint32_t)*data)>>24));
+
+  return __rbit(crc_reg);
+}
+#endif
+
+typedef uint32_t (*Checksum_impl)(const unsigned char *data, size_t bytes);
+
+static Checksum_impl select_checksum(void){
+#ifdef CRC_PCLMUL
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3"))
+    return pclmul_checksum;
+#endif
+#ifdef CRC_ARMV8
+  if(getauxval(AT_HWCAP)&HWCAP_CRC32)
+    return armv8_checksum;
+#endif
+  return checksum_slicing;
+}
+
+uint32_t checksum(const unsigned char *data, size_t bytes){
+  static const Checksum_impl impl=select_checksum();
+
+  return impl(data,bytes);
+}
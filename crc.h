@@ -1,8 +1,16 @@
 #ifndef _CRC_H
 #define _CRC_H
 
+#include <stddef.h>
 #include <stdint.h>
 
-uint32_t checksum(unsigned char *data, int bytes);
+// Ogg page CRC: polynomial 0x04c11db7, not reflected, zero initial value.
+// Uses carry-less multiply or the ARMv8 CRC instructions when the CPU has
+// them, slicing-by-8 otherwise; all paths give the same result.
+uint32_t checksum(const unsigned char *data, size_t bytes);
+
+// the portable paths, kept callable for comparison
+uint32_t checksum_bytewise(const unsigned char *data, size_t bytes);
+uint32_t checksum_slicing(const unsigned char *data, size_t bytes);
 
 #endif
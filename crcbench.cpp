@@ -0,0 +1,89 @@
+/*
+soundextract
+Copyright 2018 Jonathan wilson
+Copyright 2020 Sławomir Śpiewak
+
+Soundextract is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version. See the file COPYING for more details.
+*/
+
+//Ogg page CRC throughput: soundextract-crcbench [seconds per case]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "crc.h"
+
+typedef uint32_t (*Checksum_fn)(const unsigned char *data, size_t bytes);
+
+//GB/s over pages of the given size, run for roughly the given time
+static double Measure(Checksum_fn fn, const std::vector<unsigned char> &buffer, size_t pageSize, double seconds, uint32_t &sink)
+{
+    typedef std::chrono::steady_clock Clock;
+    size_t pages = buffer.size() / pageSize;
+    size_t bytes = 0;
+    Clock::time_point start = Clock::now();
+    double elapsed = 0;
+    do
+    {
+        for (size_t i = 0; i < pages; i++)
+        {
+            sink ^= fn(buffer.data() + i * pageSize, pageSize);
+        }
+        bytes += pages * pageSize;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (elapsed < seconds);
+    return bytes / elapsed / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 0.5;
+    std::vector<unsigned char> buffer(1 << 22);
+    std::mt19937 rng(1);
+    for (auto &b : buffer)
+    {
+        b = static_cast<unsigned char>(rng());
+    }
+
+    //every path has to agree with the reference before its speed means anything
+    for (size_t size = 0; size < 70000; size += size < 300 ? 1 : 997)
+    {
+        uint32_t expected = checksum_bytewise(buffer.data() + 1, size);
+        if (checksum_slicing(buffer.data() + 1, size) != expected || checksum(buffer.data() + 1, size) != expected)
+        {
+            fprintf(stderr, "checksum mismatch at %zu bytes\n", size);
+            return 1;
+        }
+    }
+
+    //a typical audio page, and a full 255 segment one
+    const size_t pageSizes[] = { 4096, 65307 };
+    const struct
+    {
+        const char *name;
+        Checksum_fn fn;
+    } impls[] = {
+        { "bytewise", checksum_bytewise },
+        { "slicing-by-8", checksum_slicing },
+        { "checksum", checksum },
+    };
+    uint32_t sink = 0;
+    printf("%-14s %10s %10s\n", "", "4 KiB", "64 KiB");
+    for (const auto &impl : impls)
+    {
+        printf("%-14s", impl.name);
+        for (size_t pageSize : pageSizes)
+        {
+            printf(" %6.2f GB/s", Measure(impl.fn, buffer, pageSize, seconds, sink));
+        }
+        printf("\n");
+    }
+    //keep the results alive so the loops aren't optimized out
+    volatile uint32_t keep = sink;
+    (void)keep;
+    return 0;
+}
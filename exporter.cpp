@@ -0,0 +1,475 @@
+/*
+soundextract
+Copyright 2018 Jonathan wilson
+Copyright 2020 Sławomir Śpiewak
+
+Soundextract is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version. See the file COPYING for more details.
+*/
+
+//parallel export shared by the GUI and the command line tool
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "boundedqueue.h"
+#include "exporter.h"
+#include "fileio.h"
+#include "hash.h"
+#include "manifest.h"
+#include "perf.h"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+//[begin, end) of the sounds a worker still owns. The owner takes from the
+//front, thieves split off the back, so both keep walking DATA forwards.
+struct alignas(64) WorkRange
+{
+    std::mutex mutex;
+    size_t begin = 0;
+    size_t end = 0;
+
+    bool Pop(size_t &index)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (begin == end)
+        {
+            return false;
+        }
+        index = begin++;
+        return true;
+    }
+
+    size_t Size()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return end - begin;
+    }
+};
+}
+
+//take the back half of the fullest other range into ranges[self]
+static bool Steal(std::vector<WorkRange> &ranges, size_t self)
+{
+    for (;;)
+    {
+        size_t victim = self;
+        size_t most = 0;
+        for (size_t i = 0; i < ranges.size(); i++)
+        {
+            size_t size = i == self ? 0 : ranges[i].Size();
+            if (size > most)
+            {
+                most = size;
+                victim = i;
+            }
+        }
+        if (victim == self)
+        {
+            return false;
+        }
+
+        size_t begin, end;
+        {
+            std::lock_guard<std::mutex> lock(ranges[victim].mutex);
+            size_t size = ranges[victim].end - ranges[victim].begin;
+            if (size == 0)
+            {
+                //drained since we looked, look again
+                continue;
+            }
+            end = ranges[victim].end;
+            begin = end - (size + 1) / 2;
+            ranges[victim].end = begin;
+        }
+        std::lock_guard<std::mutex> lock(ranges[self].mutex);
+        ranges[self].begin = begin;
+        ranges[self].end = end;
+        return true;
+    }
+}
+
+namespace
+{
+//what the workers of one export share besides the session
+struct ExportState
+{
+    ExportManifest manifest;
+    std::string converter;
+    ExportProgress &progress;
+
+    explicit ExportState(ExportProgress &progress) : progress(progress) {}
+
+    bool Cancelled() const
+    {
+        return progress.cancel.load(std::memory_order_relaxed);
+    }
+    void Add(std::atomic<uint64_t> &counter, uint64_t bytes)
+    {
+        counter.fetch_add(bytes, std::memory_order_relaxed);
+    }
+};
+}
+
+//count a sound as finished and tell the caller, with why it failed
+static void Finish(ExportState &state, const Sound &sound, bool ok, const ExportCallback &done, const std::string &error = std::string())
+{
+    if (!ok)
+    {
+        state.progress.failed.fetch_add(1, std::memory_order_relaxed);
+    }
+    state.progress.done.fetch_add(1, std::memory_order_relaxed);
+    if (done)
+    {
+        done(sound, ok, error);
+    }
+}
+
+static std::string ReadError(const Sound &sound)
+{
+    if (sound.streamed)
+        return "cannot read " + WemFileName(sound);
+    return "media isn't in any loaded bank";
+}
+
+//the bank the workers are in now, for progress reports
+static void EnterBank(ExportState &state, const SoundBank *bank)
+{
+    if (bank)
+    {
+        state.progress.bank.store(bank, std::memory_order_relaxed);
+    }
+}
+
+//fill in the input side of sound's manifest entry; true if its file is
+//already up to date and it can be skipped
+static bool Unchanged(const ExportSession &session, ExportState &state, const Sound &sound, const SoundInput &input, ManifestEntry &entry)
+{
+    entry.mediaId = sound.id;
+    entry.inputHash = Hash64(input.data, static_cast<size_t>(input.size));
+    entry.converter = state.converter;
+    std::string fileName;
+    if (session.incremental && SoundFileName(sound, input, session.dirExport, session.options, fileName) && state.manifest.UpToDate(fileName, entry))
+    {
+        state.progress.unchanged.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+//record a written output, revorbed if it needed it
+static void RecordOutput(ExportState &state, const SoundOutput &output, ManifestEntry &entry)
+{
+    std::error_code ec;
+    entry.outputSize = fs::file_size(output.fileName, ec);
+    if (ec)
+    {
+        state.manifest.Forget(output.fileName);
+        return;
+    }
+    state.manifest.Record(output.fileName, entry);
+}
+
+namespace
+{
+struct PipelineItem
+{
+    const Sound *sound;
+    SoundInput input;
+    SoundOutput output;
+    ManifestEntry entry;
+};
+}
+
+//touch every page of an in-bank view so the converter doesn't fault them in
+static void Prefetch(const SoundInput &input)
+{
+    volatile char sink = 0;
+    for (long i = 0; i < input.size; i += 4096)
+    {
+        sink ^= input.data[i];
+    }
+    (void)sink;
+}
+
+//reader -> converters -> writer; the calling thread is the writer
+static void PipelineExport(const ExportSession &session, const std::vector<Sound> &sounds, size_t jobs, ExportState &state, const ExportCallback &done)
+{
+    BoundedQueue<std::unique_ptr<PipelineItem>> read(session.queueDepth), converted(session.queueDepth);
+    std::atomic<size_t> converters(jobs);
+
+    //streamed files are read a queue's worth at a time, all in flight at once
+    std::thread reader([&]()
+    {
+        BatchIO io(session.queueDepth, session.ioUring);
+        std::shared_ptr<const SoundBank> bank;
+        for (size_t first = 0; first < sounds.size() && !state.Cancelled(); first += session.queueDepth)
+        {
+            size_t last = std::min<size_t>(first + session.queueDepth, sounds.size());
+            std::vector<FileRead> files;
+            for (size_t i = first; i < last; i++)
+            {
+                if (sounds[i].streamed)
+                {
+                    files.emplace_back();
+                    files.back().path = WemFileName(sounds[i]);
+                }
+            }
+            io.ReadFiles(files);
+
+            auto file = files.begin();
+            for (size_t i = first; i < last; i++)
+            {
+                const Sound &sound = sounds[i];
+                std::unique_ptr<PipelineItem> item(new PipelineItem);
+                item->sound = &sound;
+                if (sound.streamed)
+                {
+                    bool ok = file->ok;
+                    item->input.buffer = std::move(file->data);
+                    item->input.data = item->input.buffer.data();
+                    item->input.size = static_cast<long>(item->input.buffer.size());
+                    ++file;
+                    if (!ok)
+                    {
+                        Finish(state, sound, false, done, ReadError(sound));
+                        continue;
+                    }
+                    PERF_COUNT(BytesRead, item->input.size);
+                    if (i == first || sound.bankPath != sounds[i - 1].bankPath)
+                        EnterBank(state, session.index.FindBank(sound.bankPath));
+                }
+                else
+                {
+                    if (!ReadSound(sound, session.index, item->input))
+                    {
+                        Finish(state, sound, false, done, ReadError(sound));
+                        continue;
+                    }
+                    if (item->input.bank && item->input.bank != bank)
+                    {
+                        bank = item->input.bank;
+                        AdviseBank(*bank, BankAccess::Sequential);
+                        EnterBank(state, bank.get());
+                    }
+                    Prefetch(item->input);
+                }
+                state.Add(state.progress.bytesIn, static_cast<uint64_t>(item->input.size));
+                read.Push(item);
+            }
+        }
+        read.Close();
+    });
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < jobs; i++)
+    {
+        threads.emplace_back([&]()
+        {
+            std::unique_ptr<PipelineItem> item;
+            while (read.Pop(item))
+            {
+                //drain what was read before the cancel without converting it
+                if (state.Cancelled())
+                {
+                    continue;
+                }
+                if (Unchanged(session, state, *item->sound, item->input, item->entry))
+                {
+                    Finish(state, *item->sound, true, done);
+                    continue;
+                }
+                bool ok = ConvertSound(*item->sound, item->input, session.dirExport, session.options, item->output);
+                item->input = SoundInput();
+                if (ok)
+                {
+                    converted.Push(item);
+                }
+                else
+                {
+                    Finish(state, *item->sound, false, done, item->output.error);
+                }
+            }
+            if (--converters == 0)
+            {
+                converted.Close();
+            }
+        });
+    }
+
+    //write whatever has piled up in one batch
+    BatchIO io(session.queueDepth, session.ioUring);
+    std::vector<std::unique_ptr<PipelineItem>> batch;
+    std::unique_ptr<PipelineItem> item;
+    while (converted.Pop(item))
+    {
+        batch.push_back(std::move(item));
+        while (batch.size() < session.queueDepth && converted.TryPop(item))
+        {
+            batch.push_back(std::move(item));
+        }
+        std::vector<FileWrite> writes(batch.size());
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            writes[i].path = batch[i]->output.fileName;
+            writes[i].data = &batch[i]->output.data;
+        }
+        io.WriteFiles(writes);
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            bool ok = writes[i].ok;
+            if (ok)
+            {
+                state.Add(state.progress.bytesOut, batch[i]->output.data.size());
+                PERF_COUNT(BytesWritten, batch[i]->output.data.size());
+                RevorbSound(batch[i]->output);
+                RecordOutput(state, batch[i]->output, batch[i]->entry);
+            }
+            else
+            {
+                state.manifest.Forget(batch[i]->output.fileName);
+            }
+            Finish(state, *batch[i]->sound, ok, done, ok ? std::string() : "cannot write " + batch[i]->output.fileName);
+        }
+        batch.clear();
+    }
+
+    reader.join();
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+}
+
+//every worker reads, converts and writes its own range of sounds
+static void StealingExport(const ExportSession &session, const std::vector<Sound> &sounds, size_t jobs, ExportState &state, const ExportCallback &done)
+{
+    jobs = std::min(jobs, sounds.size());
+    std::vector<WorkRange> ranges(jobs);
+    for (size_t i = 0; i < jobs; i++)
+    {
+        ranges[i].begin = i * sounds.size() / jobs;
+        ranges[i].end = (i + 1) * sounds.size() / jobs;
+    }
+
+    auto worker = [&](size_t self)
+    {
+        //the bank this worker is in; holding it keeps it mapped for as long
+        //as any worker still reads from it
+        std::shared_ptr<const SoundBank> bank;
+        size_t index;
+        while (!state.Cancelled() && (ranges[self].Pop(index) || (Steal(ranges, self) && ranges[self].Pop(index))))
+        {
+            const Sound &sound = sounds[index];
+            SoundInput input;
+            SoundOutput output;
+            ManifestEntry entry;
+            std::string error;
+            bool ok = ReadSound(sound, session.index, input);
+            if (!ok)
+            {
+                error = ReadError(sound);
+            }
+            else
+            {
+                //in-bank media moves the worker on to the bank it came from
+                if (input.bank && input.bank != bank)
+                {
+                    bank = input.bank;
+                    AdviseBank(*bank, BankAccess::Sequential);
+                    EnterBank(state, bank.get());
+                }
+                else if (sound.streamed && (!bank || bank->path != sound.bankPath))
+                {
+                    EnterBank(state, session.index.FindBank(sound.bankPath));
+                }
+                state.Add(state.progress.bytesIn, static_cast<uint64_t>(input.size));
+            }
+            if (ok && Unchanged(session, state, sound, input, entry))
+            {
+                Finish(state, sound, true, done);
+                continue;
+            }
+            if (ok && !ConvertSound(sound, input, session.dirExport, session.options, output))
+            {
+                ok = false;
+                error = output.error;
+            }
+            if (ok)
+            {
+                ok = WriteSound(output);
+                if (!ok)
+                    error = "cannot write " + output.fileName;
+            }
+            if (ok)
+            {
+                state.Add(state.progress.bytesOut, output.data.size());
+                RecordOutput(state, output, entry);
+            }
+            else
+            {
+                if (!output.fileName.empty())
+                    state.manifest.Forget(output.fileName);
+            }
+            Finish(state, sound, ok, done, error);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < jobs; i++)
+    {
+        threads.emplace_back(worker, i);
+    }
+    worker(0);
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+}
+
+size_t ExportSounds(const ExportSession &session, const ExportCallback &done, ExportProgress *progress)
+{
+    ExportProgress ownProgress;
+    ExportState state(progress ? *progress : ownProgress);
+    state.progress.total.store(session.sounds.size(), std::memory_order_relaxed);
+
+    //bank by bank, each bank's media in DATA order
+    std::map<std::string, std::vector<Sound>> perBank;
+    for (const auto &sound : session.sounds)
+    {
+        perBank[sound.bankPath].push_back(sound);
+    }
+    std::vector<Sound> sounds;
+    sounds.reserve(session.sounds.size());
+    for (auto &bank : perBank)
+    {
+        SortByBankOffset(session.index, bank.second);
+        sounds.insert(sounds.end(), bank.second.begin(), bank.second.end());
+    }
+
+    if (!sounds.empty())
+    {
+        state.manifest.Load(session.dirExport);
+        state.converter = ConverterVersion(session.options);
+        size_t jobs = session.jobs ? session.jobs : std::max(1u, std::thread::hardware_concurrency());
+        if (session.queueDepth)
+        {
+            PipelineExport(session, sounds, jobs, state, done);
+        }
+        else
+        {
+            StealingExport(session, sounds, jobs, state, done);
+        }
+        state.manifest.Save();
+    }
+    size_t failed = state.progress.failed.load(std::memory_order_relaxed);
+    state.progress.finished.store(true, std::memory_order_release);
+    return failed;
+}
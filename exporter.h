@@ -0,0 +1,85 @@
+#ifndef _EXPORTER_H
+#define _EXPORTER_H
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+#include "soundbank.h"
+#include "extract.h"
+
+//called on a worker thread as each sound finishes; error says why a sound
+//failed and is empty when it didn't
+typedef std::function<void(const Sound &sound, bool ok, const std::string &error)> ExportCallback;
+
+//everything one extraction run needs; runs share nothing, so several
+//sessions (a GUI export and a batch job, say) can be in flight at once
+struct ExportSession
+{
+    MediaIndex index;               //every bank the sounds come from
+    std::vector<Sound> sounds;
+    std::string dirExport;
+    ExtractOptions options;
+    unsigned int jobs = 0;          //worker threads, 0 for hardware concurrency
+    //0: every worker reads, converts and writes its own sounds. Otherwise a
+    //reader thread, `jobs` converters and a writer thread hand sounds on
+    //through queues this deep, so disk and CPU work overlap.
+    unsigned int queueDepth = 0;
+    //with queues, streamed reads and output writes go through io_uring
+    //in batches where the system has it
+    bool ioUring = true;
+    //skip sounds whose wem and converter match what dirExport's manifest
+    //recorded for their file; the manifest is kept up to date either way
+    bool incremental = true;
+};
+
+//live counters of one export. Workers bump them without locking as they
+//go, any thread may read them while it runs (a UI timer, say) and set
+//cancel to have every worker stop before its next sound.
+struct ExportProgress
+{
+    std::atomic<size_t> total{0};           //sounds in the run, set before any starts
+    std::atomic<size_t> done{0};            //converted, skipped or failed so far
+    std::atomic<size_t> failed{0};
+    std::atomic<size_t> unchanged{0};       //skipped as up to date
+    std::atomic<uint64_t> bytesIn{0};       //media read
+    std::atomic<uint64_t> bytesOut{0};      //files written
+    //bank the export last moved on to, owned by the session's index
+    std::atomic<const SoundBank *> bank{nullptr};
+    std::atomic<bool> cancel{false};
+    //set once the export has returned and the manifest is saved
+    std::atomic<bool> finished{false};
+};
+
+//convert every sound in the session. Sounds are laid out bank by bank in
+//DATA offset order; without queues they're split into one range per worker
+//and a worker that runs dry steals the back half of the fullest range.
+//Blocks until all are done or progress is cancelled and returns how many
+//failed. The index must already hold every bank.
+size_t ExportSounds(const ExportSession &session, const ExportCallback &done = ExportCallback(), ExportProgress *progress = nullptr);
+
+//one export as an object, for running it off the caller's thread: hand
+//Run() to a std::thread or a thread pool task, then poll Progress() and
+//Cancel() from anywhere. The session must outlive the job and stay
+//untouched until Progress().finished is set.
+class ExportJob
+{
+public:
+    explicit ExportJob(const ExportSession &session, ExportCallback done = ExportCallback())
+        : session(session), done(std::move(done)) {}
+    ExportJob(const ExportJob &) = delete;
+    ExportJob &operator=(const ExportJob &) = delete;
+
+    //export on the calling thread; run a job only once
+    void Run() { ExportSounds(session, done, &progress); }
+    void Cancel() { progress.cancel.store(true, std::memory_order_relaxed); }
+    const ExportProgress &Progress() const { return progress; }
+    bool Finished() const { return progress.finished.load(std::memory_order_acquire); }
+
+private:
+    const ExportSession &session;
+    ExportCallback done;
+    ExportProgress progress;
+};
+
+#endif // _EXPORTER_H
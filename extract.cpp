@@ -0,0 +1,410 @@
+/*
+soundextract
+Copyright 2018 Jonathan wilson
+Copyright 2020 Sławomir Śpiewak
+
+Soundextract is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version. See the file COPYING for more details.
+*/
+
+/* WWISE ADPCM decode algorithm and related information taken from reformat.c (copyright for that is given below)
+
+The MIT License (MIT)
+
+Copyright (c) 2016 Victor Dmitriyev
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+//single sound conversion, shared by the GUI and the command line tool
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+#include <sstream>
+#include <vector>
+#include "adpcm.h"
+#include "perf.h"
+#include "vorbisdecode.h"
+#include "wwriff.h"
+#include "extract.h"
+
+namespace fs = std::filesystem;
+
+int revorb(const char *fname);
+
+//bump whenever a change alters converted output, so incremental exports redo everything
+static const char converterRevision[] = "1";
+
+static bool ReadWem(const std::string &infname, std::vector<char> &outdata)
+{
+    FILE *infile = fopen(infname.c_str(), "rb");
+    if (!infile)
+    {
+        return false;
+    }
+    fseek(infile, 0, SEEK_END);
+    long size = ftell(infile);
+    fseek(infile, 0, SEEK_SET);
+    outdata.resize(size);
+    size_t read = fread(outdata.data(), sizeof(outdata[0]), size, infile);
+    fclose(infile);
+    return read == static_cast<size_t>(size);
+}
+
+//find the data chunk following fmt; false if there isn't a non-empty one
+static bool FindDataChunk(const char *ptr, const char *end, const char *&datapos, UInt32 &datasize)
+{
+    datapos = nullptr;
+    datasize = 0;
+    while (ptr + sizeof(ChunkHeader) <= end)
+    {
+        ChunkHeader header = *reinterpret_cast<const ChunkHeader *>(ptr);
+        ptr += sizeof(ChunkHeader);
+        if (header.ChunkId == dataChunkId)
+        {
+            datapos = ptr;
+            datasize = header.dwChunkSize;
+        }
+        ptr += header.dwChunkSize;
+    }
+    return datapos && datasize && datapos + datasize <= end;
+}
+
+static void AppendWavHeader(std::vector<char> &out, WaveFormatExtensible &format, UInt32 datasize)
+{
+    auto append = [&out](const void *p, size_t n)
+    {
+        out.insert(out.end(), static_cast<const char *>(p), static_cast<const char *>(p) + n);
+    };
+    ChunkHeader header;
+    header.ChunkId = RIFFChunkId;
+    header.dwChunkSize = sizeof(Fourcc) + sizeof(ChunkHeader) + sizeof(WaveFormatExtensible) + sizeof(ChunkHeader) + datasize;
+    append(&header, sizeof(header));
+    Fourcc fcc = WAVEChunkId;
+    append(&fcc, sizeof(fcc));
+    header.ChunkId = fmtChunkId;
+    header.dwChunkSize = sizeof(WaveFormatExtensible);
+    append(&header, sizeof(header));
+    append(&format, sizeof(format));
+    header.ChunkId = dataChunkId;
+    header.dwChunkSize = datasize;
+    append(&header, sizeof(header));
+}
+
+bool ReadSound(const Sound &sound, const MediaIndex &index, SoundInput &input)
+{
+    input.buffer.clear();
+    input.bank.reset();
+    if (sound.streamed)
+    {
+        PERF_TIME(ReadFiles);
+        if (!ReadWem(WemFileName(sound), input.buffer))
+        {
+            return false;
+        }
+        PERF_COUNT(BytesRead, input.buffer.size());
+        input.data = input.buffer.data();
+        input.size = static_cast<long>(input.buffer.size());
+        return true;
+    }
+    MediaID id;
+    if (!ParseMediaID(sound.id, id))
+    {
+        return false;
+    }
+    //Wwise may put the same media in several banks; pin the one the bytes come from
+    const MediaIndex::Location *location = index.Find(id);
+    if (!location)
+    {
+        return false;
+    }
+    input.bank = index.ShareBank(*location);
+    input.data = input.bank->data + location->uOffset;
+    input.size = static_cast<long>(location->uSize);
+    return true;
+}
+
+//check the RIFF and fmt headers; format is the fmt chunk, ptr the chunk after
+//it and ext the extension the converted sound gets
+static bool ReadFormat(const SoundInput &input, const ExtractOptions &options, WaveFormatExtensible &format, const char *&ptr, std::string &ext)
+{
+    if (input.size < static_cast<long>(sizeof(Fourcc) + sizeof(UInt32) + sizeof(Fourcc) + sizeof(ChunkHeader) + sizeof(WaveFormatExtensible)))
+    {
+        return false;
+    }
+
+    ptr = input.data;
+    if (*reinterpret_cast<const Fourcc *>(ptr) != RIFFChunkId)
+    {
+        return false;
+    }
+    ptr += sizeof(Fourcc);
+    ptr += sizeof(UInt32);
+    if (*reinterpret_cast<const Fourcc *>(ptr) != WAVEChunkId)
+    {
+        return false;
+    }
+    ptr += sizeof(Fourcc);
+    ChunkHeader header = *reinterpret_cast<const ChunkHeader *>(ptr);
+    if (header.ChunkId != fmtChunkId)
+    {
+        return false;
+    }
+    ptr += sizeof(ChunkHeader);
+    format = *reinterpret_cast<const WaveFormatExtensible *>(ptr);
+    ptr += sizeof(WaveFormatExtensible);
+    if (format.wFormatTag == 2 || format.wFormatTag == 0xFFFE)
+    {
+        if (header.dwChunkSize != sizeof(WaveFormatExtensible))
+        {
+            return false;
+        }
+        ext = ".wav";
+    }
+    else if (format.wFormatTag == 0xFFFF)
+    {
+        //fmt and vorb chunks come in several layouts; Wwise_RIFF_Vorbis checks them
+        ext = options.decodeVorbis ? ".wav" : ".ogg";
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+static std::string OutputFileName(const Sound &sound, const std::string &dirExport, const std::string &ext)
+{
+    std::string relativePath = sound.relativePath;
+    if (relativePath == "SFX") {
+        relativePath += "/" + fs::path(sound.bankPath).filename().string().substr(0, fs::path(sound.bankPath).filename().string().find('.'));
+    }
+    return (fs::path(dirExport) / relativePath / (sound.name + ext)).string();
+}
+
+bool SoundFileName(const Sound &sound, const SoundInput &input, const std::string &dirExport, const ExtractOptions &options, std::string &fileName)
+{
+    WaveFormatExtensible format;
+    const char *ptr;
+    std::string ext;
+    if (!ReadFormat(input, options, format, ptr, ext))
+    {
+        return false;
+    }
+    fileName = OutputFileName(sound, dirExport, ext);
+    return true;
+}
+
+std::string ConverterVersion(const ExtractOptions &options)
+{
+    std::string version = std::string("soundextract-") + converterRevision + "/ww2ogg-" VERSION;
+    if (options.revorbPass)
+        version += "/revorb";
+    if (options.decodeAdpcm)
+        version += "/adpcm-pcm";
+    if (options.decodeVorbis)
+        version += "/vorbis-pcm";
+    return version;
+}
+
+static bool Fail(SoundOutput &output, const std::string &why)
+{
+    output.error = why;
+    return false;
+}
+
+bool ConvertSound(const Sound &sound, const SoundInput &input, const std::string &dirExport, const ExtractOptions &options, SoundOutput &output)
+{
+    PERF_TIME(Convert);
+    const char *indata = input.data;
+    long size = input.size;
+    output.data.clear();
+    output.revorb = false;
+    output.error.clear();
+
+    WaveFormatExtensible format;
+    const char *ptr;
+    const char *end = indata + size;
+    std::string ext;
+    if (!ReadFormat(input, options, format, ptr, ext))
+    {
+        return Fail(output, "not a RIFF wem in a format this converter handles");
+    }
+    output.fileName = OutputFileName(sound, dirExport, ext);
+
+    if (format.wFormatTag == 2)
+    {
+        if (format.nChannels == 0 || format.nBlockAlign < 4 * format.nChannels || format.wBitsPerSample == 0)
+        {
+            return Fail(output, "malformed ADPCM format chunk");
+        }
+        const char *datapos;
+        UInt32 datasize;
+        if (!FindDataChunk(ptr, end, datapos, datasize))
+        {
+            return Fail(output, "no data chunk");
+        }
+        if (options.decodeAdpcm && format.wBitsPerSample == 4 && format.nBlockAlign % (4 * format.nChannels) == 0)
+        {
+            PERF_TIME(Decode);
+            //whole blocks only, like the multichannel IMA output
+            size_t blockAlign = format.nBlockAlign;
+            size_t blockAmount = datasize / blockAlign;
+            size_t samples = blockAmount * AdpcmSamplesPerBlock(format.nChannels, blockAlign) * format.nChannels;
+            if (samples * sizeof(int16_t) > 0xFFFFFFFFu - 36)
+            {
+                return Fail(output, "decoded ADPCM too large for a WAV");
+            }
+            format.wFormatTag = 0x1;
+            format.wBitsPerSample = 16;
+            format.nBlockAlign = format.nChannels * sizeof(int16_t);
+            format.nAvgBytesPerSec = format.nSamplesPerSec * format.nBlockAlign;
+            AppendWavHeader(output.data, format, static_cast<UInt32>(samples * sizeof(int16_t)));
+            size_t headerSize = output.data.size();
+            output.data.resize(headerSize + samples * sizeof(int16_t));
+            DecodeAdpcmBlocks(reinterpret_cast<const uint8_t *>(datapos), reinterpret_cast<int16_t *>(output.data.data() + headerSize),
+                blockAmount, format.nChannels, blockAlign, options.decodeThreads);
+            return true;
+        }
+        format.wFormatTag = 0x11;
+        format.wSamplesPerBlock = (format.nBlockAlign - 4 * format.nChannels) * 8 / (format.wBitsPerSample * format.nChannels) + 1;
+        AppendWavHeader(output.data, format, datasize);
+        size_t headerSize = output.data.size();
+        if (format.nChannels > 1)
+        {
+            //whole blocks only, a trailing partial block is dropped
+            size_t blockAmount = datasize / format.nBlockAlign;
+            output.data.resize(headerSize + blockAmount * format.nBlockAlign);
+            DeinterleaveAdpcmBlocks(reinterpret_cast<const uint8_t *>(datapos), reinterpret_cast<uint8_t *>(output.data.data() + headerSize),
+                blockAmount, format.nChannels, format.nBlockAlign);
+        }
+        else
+        {
+            output.data.insert(output.data.end(), datapos, datapos + datasize);
+        }
+        return true;
+    }
+    else if (format.wFormatTag == 0xFFFE)
+    {
+        format.wFormatTag = 0x1;
+        const char *datapos;
+        UInt32 datasize;
+        if (!FindDataChunk(ptr, end, datapos, datasize))
+        {
+            return Fail(output, "no data chunk");
+        }
+        AppendWavHeader(output.data, format, datasize);
+        output.data.insert(output.data.end(), datapos, datapos + datasize);
+        return true;
+    }
+    else
+    {
+        try
+        {
+            Wwise_RIFF_Vorbis ww(indata, size, sound.name);
+            if (options.decodeVorbis)
+            {
+                PERF_TIME(Decode);
+                //the header goes in front once the PCM size is known
+                AppendWavHeader(output.data, format, 0);
+                size_t headerSize = output.data.size();
+                unsigned int channels, rate;
+                if (!DecodeVorbis(ww, output.data, channels, rate))
+                {
+                    return Fail(output, "libvorbis rejected the headers");
+                }
+                size_t datasize = output.data.size() - headerSize;
+                if (datasize > 0xFFFFFFFFu - 36)
+                {
+                    return Fail(output, "decoded Vorbis too large for a WAV");
+                }
+                format.wFormatTag = 0x1;
+                format.nChannels = static_cast<UInt16>(channels);
+                format.nSamplesPerSec = rate;
+                format.wBitsPerSample = 16;
+                format.nBlockAlign = static_cast<UInt16>(channels * sizeof(int16_t));
+                format.nAvgBytesPerSec = rate * format.nBlockAlign;
+                std::vector<char> wavHeader;
+                AppendWavHeader(wavHeader, format, static_cast<UInt32>(datasize));
+                memcpy(output.data.data(), wavHeader.data(), headerSize);
+                return true;
+            }
+            vector_streambuf buf(output.data);
+            ostream out(&buf);
+            ww.generate_ogg(out);
+            //granules are written in the same pass; the old revorb pass stays for checking them
+            output.revorb = ww.needs_revorb() || options.revorbPass;
+        }
+        catch (const Parse_error &e)
+        {
+            ostringstream why;
+            why << e;
+            return Fail(output, why.str());
+        }
+        catch (const File_open_error &e)
+        {
+            ostringstream why;
+            why << e;
+            return Fail(output, why.str());
+        }
+        catch (...)
+        {
+            return Fail(output, "conversion failed");
+        }
+        return true;
+    }
+}
+
+bool WriteSound(const SoundOutput &output)
+{
+    {
+        PERF_TIME(WriteFiles);
+        std::error_code ec;
+        fs::create_directories(fs::path(output.fileName).parent_path(), ec);
+        FILE *outfile = fopen(output.fileName.c_str(), "wb");
+        if (!outfile)
+        {
+            return false;
+        }
+        size_t written = fwrite(output.data.data(), 1, output.data.size(), outfile);
+        if (fclose(outfile) != 0 || written != output.data.size())
+        {
+            return false;
+        }
+        PERF_COUNT(BytesWritten, written);
+    }
+    RevorbSound(output);
+    return true;
+}
+
+void RevorbSound(const SoundOutput &output)
+{
+    if (output.revorb)
+    {
+        PERF_TIME(Revorb);
+        revorb(output.fileName.c_str());
+    }
+}
+
+bool ExtractSound(const Sound &sound, const MediaIndex &index, const std::string &dirExport, const ExtractOptions &options)
+{
+    SoundInput input;
+    SoundOutput output;
+    if (!ReadSound(sound, index, input))
+    {
+        return false;
+    }
+    if (!ConvertSound(sound, input, dirExport, options, output))
+    {
+        cerr << sound.name << ": " << output.error << endl;
+        return false;
+    }
+    return WriteSound(output);
+}
@@ -0,0 +1,60 @@
+#ifndef _EXTRACT_H
+#define _EXTRACT_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "soundbank.h"
+
+struct ExtractOptions
+{
+    //rerun revorb on every Ogg, not only on the ones generate_ogg can't fix up itself
+    bool revorbPass = false;
+    //write ADPCM sounds as 16 bit PCM instead of retagging them as IMA ADPCM
+    bool decodeAdpcm = false;
+    //threads one long ADPCM sound may be decoded on
+    unsigned int decodeThreads = 1;
+    //write Vorbis sounds as 16 bit PCM WAVs instead of Oggs
+    bool decodeVorbis = false;
+};
+
+//a sound's wem: the streamed file read into buffer, or a view of the mapped
+//bank, which bank keeps alive
+struct SoundInput
+{
+    std::vector<char> buffer;
+    std::shared_ptr<const SoundBank> bank;
+    const char *data = nullptr;
+    long size = 0;
+};
+
+//a converted sound waiting to be written
+struct SoundOutput
+{
+    std::string fileName;
+    std::vector<char> data;
+    bool revorb = false;            //run revorb over the file once it's written
+    std::string error;              //why ConvertSound failed, for the log
+};
+
+//where ConvertSound will put the sound; false if it isn't a wem it handles
+bool SoundFileName(const Sound &sound, const SoundInput &input, const std::string &dirExport, const ExtractOptions &options, std::string &fileName);
+//identifies the conversion code and the options that change its output
+std::string ConverterVersion(const ExtractOptions &options);
+
+//the three steps of ExtractSound, so they can run on different threads.
+//Each returns false on a missing or malformed sound; nothing is written
+//unless conversion succeeded.
+bool ReadSound(const Sound &sound, const MediaIndex &index, SoundInput &input);
+bool ConvertSound(const Sound &sound, const SoundInput &input, const std::string &dirExport, const ExtractOptions &options, SoundOutput &output);
+bool WriteSound(const SoundOutput &output);
+//the revorb pass WriteSound ends with, for outputs written some other way
+void RevorbSound(const SoundOutput &output);
+
+//convert one sound to dirExport/<relativePath>/<name>.{wav,ogg}. In-memory
+//sounds are looked up in index, which must already hold their bank.
+//Thread-safe as long as callers write to different files. false on a
+//missing or malformed sound.
+bool ExtractSound(const Sound &sound, const MediaIndex &index, const std::string &dirExport, const ExtractOptions &options);
+
+#endif // _EXTRACT_H
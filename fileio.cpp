@@ -0,0 +1,540 @@
+/*
+soundextract
+Copyright 2018 Jonathan wilson
+Copyright 2020 Sławomir Śpiewak
+
+Soundextract is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version. See the file COPYING for more details.
+*/
+
+//batched file I/O: io_uring when available, stdio otherwise
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#ifdef HAVE_IO_URING
+    #include <cerrno>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+    #include <linux/io_uring.h>
+#endif
+#include "fileio.h"
+#include "perf.h"
+
+namespace fs = std::filesystem;
+
+#ifdef HAVE_IO_URING
+//just enough of io_uring for batches of open/statx/read/write/close, driven
+//one round at a time: queue every request, wait for every completion
+struct BatchIO::Ring
+{
+    int fd = -1;
+    unsigned int entries = 0;
+    void *sqMap = nullptr, *cqMap = nullptr;
+    size_t sqMapSize = 0, cqMapSize = 0;
+    io_uring_sqe *sqes = nullptr;
+    size_t sqesSize = 0;
+    unsigned *sqTail = nullptr, *sqMask = nullptr, *sqArray = nullptr;
+    unsigned *cqHead = nullptr, *cqTail = nullptr, *cqMask = nullptr;
+    io_uring_cqe *cqes = nullptr;
+    bool broken = false;            //a round failed halfway, stdio from then on
+    //even waiting for a failed round's requests failed, so some may still
+    //complete: whatever memory they use is parked here and the ring is
+    //never torn down
+    bool lost = false;
+    std::vector<std::shared_ptr<void>> parked;
+
+    template <class T>
+    void Park(std::vector<T> &buffer)
+    {
+        //moving keeps the heap block the kernel was given
+        parked.push_back(std::make_shared<std::vector<T>>(std::move(buffer)));
+        buffer.clear();
+    }
+
+    ~Ring()
+    {
+        if (sqes)
+            munmap(sqes, sqesSize);
+        if (cqMap && cqMap != sqMap)
+            munmap(cqMap, cqMapSize);
+        if (sqMap)
+            munmap(sqMap, sqMapSize);
+        if (fd >= 0)
+            close(fd);
+    }
+
+    //nullptr if the kernel has no io_uring, refuses it, or predates the
+    //open/read/write/close opcodes (5.6)
+    static Ring *Create(unsigned int entries)
+    {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0)
+        {
+            return nullptr;
+        }
+        Ring *ring = new Ring;
+        ring->fd = fd;
+        ring->entries = params.sq_entries;
+        if (!(params.features & IORING_FEAT_CUR_PERSONALITY))
+        {
+            delete ring;
+            return nullptr;
+        }
+
+        ring->sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        ring->cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single)
+        {
+            ring->sqMapSize = ring->cqMapSize = std::max(ring->sqMapSize, ring->cqMapSize);
+        }
+        void *sq = mmap(nullptr, ring->sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sq == MAP_FAILED)
+        {
+            delete ring;
+            return nullptr;
+        }
+        ring->sqMap = sq;
+        void *cq = sq;
+        if (!single)
+        {
+            cq = mmap(nullptr, ring->cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            if (cq == MAP_FAILED)
+            {
+                delete ring;
+                return nullptr;
+            }
+        }
+        ring->cqMap = cq;
+        ring->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void *sqes = mmap(nullptr, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED)
+        {
+            delete ring;
+            return nullptr;
+        }
+        ring->sqes = static_cast<io_uring_sqe *>(sqes);
+
+        char *sqBase = static_cast<char *>(sq);
+        char *cqBase = static_cast<char *>(cq);
+        ring->sqTail = reinterpret_cast<unsigned *>(sqBase + params.sq_off.tail);
+        ring->sqMask = reinterpret_cast<unsigned *>(sqBase + params.sq_off.ring_mask);
+        ring->sqArray = reinterpret_cast<unsigned *>(sqBase + params.sq_off.array);
+        ring->cqHead = reinterpret_cast<unsigned *>(cqBase + params.cq_off.head);
+        ring->cqTail = reinterpret_cast<unsigned *>(cqBase + params.cq_off.tail);
+        ring->cqMask = reinterpret_cast<unsigned *>(cqBase + params.cq_off.ring_mask);
+        ring->cqes = reinterpret_cast<io_uring_cqe *>(cqBase + params.cq_off.cqes);
+        return ring;
+    }
+
+    //prepare(sqe, i) for i in [0, count); results[i] gets each request's res.
+    //false if the ring failed; every request the kernel took is still waited
+    //for, unless that fails too and the ring is lost
+    bool Run(size_t count, const std::function<void(io_uring_sqe &, size_t)> &prepare, std::vector<int> &results)
+    {
+        results.assign(count, -ECANCELED);
+        if (broken)
+        {
+            return false;
+        }
+        for (size_t first = 0; first < count; first += entries)
+        {
+            unsigned int n = static_cast<unsigned int>(std::min<size_t>(entries, count - first));
+            unsigned int tail = *sqTail;
+            for (unsigned int i = 0; i < n; i++)
+            {
+                unsigned int slot = (tail + i) & *sqMask;
+                io_uring_sqe &sqe = sqes[slot];
+                memset(&sqe, 0, sizeof(sqe));
+                prepare(sqe, first + i);
+                sqe.user_data = first + i;
+                sqArray[slot] = slot;
+            }
+            __atomic_store_n(sqTail, tail + n, __ATOMIC_RELEASE);
+
+            //after a failed submit only the requests already taken are waited for
+            unsigned int submitted = 0, completed = 0;
+            while (completed < (broken ? submitted : n))
+            {
+                unsigned int toSubmit = broken ? 0 : n - submitted;
+                unsigned int toWait = (broken ? submitted : n) - completed;
+                int ret = static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, toWait, IORING_ENTER_GETEVENTS, nullptr, 0));
+                if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+                {
+                    if (broken)
+                    {
+                        lost = true;
+                        return false;
+                    }
+                    broken = true;
+                }
+                else if (ret > 0)
+                {
+                    submitted += static_cast<unsigned int>(ret);
+                }
+                //EAGAIN and EBUSY ask for completions to be reaped before retrying
+                unsigned int head = *cqHead;
+                unsigned int cqEnd = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+                for (; head != cqEnd; head++)
+                {
+                    const io_uring_cqe &cqe = cqes[head & *cqMask];
+                    results[cqe.user_data] = cqe.res;
+                    completed++;
+                }
+                __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+            }
+            if (broken)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool Transfer(std::vector<int> &fds, std::vector<char *> &buffers, std::vector<size_t> &sizes, std::vector<bool> &ok, unsigned char opcode);
+    void CloseAll(const std::vector<int> &fds, std::vector<bool> &ok);
+};
+#else
+struct BatchIO::Ring
+{
+};
+#endif
+
+BatchIO::BatchIO(unsigned int depth, bool useRing)
+    : depth(std::max(depth, 1u))
+{
+#ifdef HAVE_IO_URING
+    if (useRing)
+    {
+        ring = Ring::Create(this->depth);
+    }
+#else
+    (void)useRing;
+#endif
+}
+
+BatchIO::~BatchIO()
+{
+#ifdef HAVE_IO_URING
+    //a lost ring's requests may still use its parked buffers, so it's kept
+    if (ring && ring->lost)
+    {
+        return;
+    }
+#endif
+    delete ring;
+}
+
+void BatchIO::MakeParent(const std::string &path)
+{
+    std::string dir = fs::path(path).parent_path().string();
+    if (dir != lastDir)
+    {
+        std::error_code ec;
+        fs::create_directories(dir, ec);
+        lastDir = dir;
+    }
+}
+
+static bool ReadFileStdio(FileRead &file)
+{
+    FILE *infile = fopen(file.path.c_str(), "rb");
+    if (!infile)
+    {
+        return false;
+    }
+    fseek(infile, 0, SEEK_END);
+    long size = ftell(infile);
+    fseek(infile, 0, SEEK_SET);
+    if (size < 0)
+    {
+        fclose(infile);
+        return false;
+    }
+    file.data.resize(size);
+    size_t read = fread(file.data.data(), 1, size, infile);
+    fclose(infile);
+    return read == static_cast<size_t>(size);
+}
+
+static bool WriteFileStdio(const FileWrite &file)
+{
+    FILE *outfile = fopen(file.path.c_str(), "wb");
+    if (!outfile)
+    {
+        return false;
+    }
+    size_t written = fwrite(file.data->data(), 1, file.data->size(), outfile);
+    return fclose(outfile) == 0 && written == file.data->size();
+}
+
+#ifdef HAVE_IO_URING
+//keep issuing the unfinished part of every transfer until each is done or failed
+bool BatchIO::Ring::Transfer(std::vector<int> &fds, std::vector<char *> &buffers, std::vector<size_t> &sizes, std::vector<bool> &ok, unsigned char opcode)
+{
+    std::vector<size_t> done(fds.size(), 0);
+    std::vector<int> results;
+    for (;;)
+    {
+        std::vector<size_t> pending;
+        for (size_t i = 0; i < fds.size(); i++)
+        {
+            if (ok[i] && done[i] < sizes[i])
+            {
+                pending.push_back(i);
+            }
+        }
+        if (pending.empty())
+        {
+            return true;
+        }
+        bool ran = Run(pending.size(), [&](io_uring_sqe &sqe, size_t n)
+        {
+            size_t i = pending[n];
+            sqe.opcode = opcode;
+            sqe.fd = fds[i];
+            sqe.addr = reinterpret_cast<uint64_t>(buffers[i] + done[i]);
+            sqe.len = static_cast<uint32_t>(std::min<size_t>(sizes[i] - done[i], 1u << 30));
+            sqe.off = done[i];
+        }, results);
+        if (!ran)
+        {
+            return false;
+        }
+        for (size_t n = 0; n < pending.size(); n++)
+        {
+            size_t i = pending[n];
+            if (results[n] > 0)
+            {
+                done[i] += results[n];
+            }
+            else if (results[n] == 0 && opcode == IORING_OP_READ)
+            {
+                //the file shrank since statx
+                sizes[i] = done[i];
+            }
+            else if (results[n] != -EINTR && results[n] != -EAGAIN)
+            {
+                ok[i] = false;
+            }
+        }
+    }
+}
+
+//an open round that failed part way may still have opened some files;
+//every stride'th result is an open's, and the fds it gave are closed here
+static void CloseOpened(const std::vector<int> &results, size_t stride)
+{
+    for (size_t i = 0; i < results.size(); i += stride)
+    {
+        if (results[i] >= 0)
+        {
+            close(results[i]);
+        }
+    }
+}
+
+void BatchIO::Ring::CloseAll(const std::vector<int> &fds, std::vector<bool> &ok)
+{
+    std::vector<size_t> open;
+    for (size_t i = 0; i < fds.size(); i++)
+    {
+        if (fds[i] >= 0)
+        {
+            open.push_back(i);
+        }
+    }
+    std::vector<int> results;
+    if (!Run(open.size(), [&](io_uring_sqe &sqe, size_t n)
+    {
+        sqe.opcode = IORING_OP_CLOSE;
+        sqe.fd = fds[open[n]];
+    }, results))
+    {
+        for (size_t i : open)
+        {
+            close(fds[i]);
+        }
+        return;
+    }
+    for (size_t n = 0; n < open.size(); n++)
+    {
+        if (results[n] < 0)
+        {
+            ok[open[n]] = false;
+        }
+    }
+}
+#endif
+
+void BatchIO::ReadFiles(std::vector<FileRead> &files)
+{
+    PERF_TIME(ReadFiles);
+#ifdef HAVE_IO_URING
+    if (ring && !ring->broken)
+    {
+        for (size_t first = 0; first < files.size(); first += depth)
+        {
+            size_t count = std::min<size_t>(depth, files.size() - first);
+            FileRead *batch = &files[first];
+
+            //open and size every file in one round
+            std::vector<struct statx> stats(count);
+            std::vector<int> results;
+            if (!ring->Run(2 * count, [&](io_uring_sqe &sqe, size_t n)
+            {
+                const char *path = batch[n / 2].path.c_str();
+                sqe.fd = AT_FDCWD;
+                sqe.addr = reinterpret_cast<uint64_t>(path);
+                if (n % 2 == 0)
+                {
+                    sqe.opcode = IORING_OP_OPENAT;
+                    sqe.open_flags = O_RDONLY | O_CLOEXEC;
+                }
+                else
+                {
+                    sqe.opcode = IORING_OP_STATX;
+                    sqe.len = STATX_SIZE;
+                    sqe.off = reinterpret_cast<uint64_t>(&stats[n / 2]);
+                }
+            }, results))
+            {
+                CloseOpened(results, 2);
+                if (ring->lost)
+                {
+                    ring->Park(stats);
+                }
+                break;
+            }
+
+            std::vector<int> fds(count);
+            std::vector<char *> buffers(count);
+            std::vector<size_t> sizes(count);
+            std::vector<bool> ok(count);
+            for (size_t i = 0; i < count; i++)
+            {
+                fds[i] = results[2 * i];
+                ok[i] = fds[i] >= 0 && results[2 * i + 1] >= 0;
+                sizes[i] = ok[i] ? static_cast<size_t>(stats[i].stx_size) : 0;
+                batch[i].data.resize(sizes[i]);
+                buffers[i] = batch[i].data.data();
+            }
+            bool transferred = ring->Transfer(fds, buffers, sizes, ok, IORING_OP_READ);
+            if (ring->lost)
+            {
+                //reads may still land in these; stdio reads into fresh buffers
+                for (size_t i = 0; i < count; i++)
+                {
+                    ring->Park(batch[i].data);
+                }
+            }
+            ring->CloseAll(fds, ok);
+            for (size_t i = 0; i < count; i++)
+            {
+                batch[i].ok = transferred && ok[i];
+                if (batch[i].ok)
+                {
+                    batch[i].data.resize(sizes[i]);
+                }
+            }
+            if (!transferred)
+            {
+                break;
+            }
+        }
+        if (!ring->broken)
+        {
+            return;
+        }
+    }
+#endif
+    for (auto &file : files)
+    {
+        if (!file.ok)
+        {
+            file.ok = ReadFileStdio(file);
+        }
+    }
+}
+
+void BatchIO::WriteFiles(std::vector<FileWrite> &files)
+{
+    PERF_TIME(WriteFiles);
+    for (const auto &file : files)
+    {
+        MakeParent(file.path);
+    }
+    //files a lost ring may still be writing, which stdio mustn't race
+    size_t lostFirst = 0, lostEnd = 0;
+#ifdef HAVE_IO_URING
+    if (ring && !ring->broken)
+    {
+        for (size_t first = 0; first < files.size(); first += depth)
+        {
+            size_t count = std::min<size_t>(depth, files.size() - first);
+            FileWrite *batch = &files[first];
+
+            std::vector<int> results;
+            if (!ring->Run(count, [&](io_uring_sqe &sqe, size_t n)
+            {
+                sqe.opcode = IORING_OP_OPENAT;
+                sqe.fd = AT_FDCWD;
+                sqe.addr = reinterpret_cast<uint64_t>(batch[n].path.c_str());
+                sqe.open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+                sqe.len = 0644;
+            }, results))
+            {
+                CloseOpened(results, 1);
+                break;
+            }
+
+            std::vector<int> fds(results.begin(), results.end());
+            std::vector<char *> buffers(count);
+            std::vector<size_t> sizes(count);
+            std::vector<bool> ok(count);
+            for (size_t i = 0; i < count; i++)
+            {
+                ok[i] = fds[i] >= 0;
+                buffers[i] = const_cast<char *>(batch[i].data->data());
+                sizes[i] = batch[i].data->size();
+            }
+            bool transferred = ring->Transfer(fds, buffers, sizes, ok, IORING_OP_WRITE);
+            if (ring->lost)
+            {
+                lostFirst = first;
+                lostEnd = first + count;
+            }
+            ring->CloseAll(fds, ok);
+            for (size_t i = 0; i < count; i++)
+            {
+                batch[i].ok = transferred && ok[i];
+            }
+            if (!transferred)
+            {
+                break;
+            }
+        }
+        if (!ring->broken)
+        {
+            return;
+        }
+    }
+#endif
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        if (!files[i].ok && (i < lostFirst || i >= lostEnd))
+        {
+            files[i].ok = WriteFileStdio(files[i]);
+        }
+    }
+}
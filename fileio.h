@@ -0,0 +1,48 @@
+#ifndef _FILEIO_H
+#define _FILEIO_H
+
+#include <string>
+#include <vector>
+
+//whole-file reads and writes, many files per call. With io_uring (Linux,
+//built with HAVE_IO_URING) every file of a batch is opened, read or written
+//and closed with all requests in flight at once; without it, or when the
+//kernel won't give us a ring, the files are handled one by one with stdio.
+struct FileRead
+{
+    std::string path;
+    std::vector<char> data;
+    bool ok = false;
+};
+
+struct FileWrite
+{
+    std::string path;               //parent directories are created
+    const std::vector<char> *data = nullptr;
+    bool ok = false;
+};
+
+class BatchIO
+{
+public:
+    //depth: most files in flight at once; useRing false forces stdio
+    explicit BatchIO(unsigned int depth = 64, bool useRing = true);
+    ~BatchIO();
+    BatchIO(const BatchIO &) = delete;
+    BatchIO &operator=(const BatchIO &) = delete;
+
+    bool UsingRing() const { return ring != nullptr; }
+
+    void ReadFiles(std::vector<FileRead> &files);
+    void WriteFiles(std::vector<FileWrite> &files);
+
+private:
+    struct Ring;
+    Ring *ring = nullptr;
+    unsigned int depth;
+    std::string lastDir;            //skips create_directories for runs of one directory
+
+    void MakeParent(const std::string &path);
+};
+
+#endif // _FILEIO_H
@@ -0,0 +1,109 @@
+/*
+soundextract
+Copyright 2018 Jonathan wilson
+Copyright 2020 Sławomir Śpiewak
+
+Soundextract is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version. See the file COPYING for more details.
+*/
+
+//XXH64, written from the xxHash specification
+#include <cstring>
+#include "hash.h"
+
+static const uint64_t prime1 = UINT64_C(0x9E3779B185EBCA87);
+static const uint64_t prime2 = UINT64_C(0xC2B2AE3D27D4EB4F);
+static const uint64_t prime3 = UINT64_C(0x165667B19E3779F9);
+static const uint64_t prime4 = UINT64_C(0x85EBCA77C2B2AE63);
+static const uint64_t prime5 = UINT64_C(0x27D4EB2F165667C5);
+
+static inline uint64_t Rotl(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+//little-endian loads, as the specification reads its input
+static inline uint64_t Read64(const unsigned char *p)
+{
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--)
+    {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+static inline uint32_t Read32(const unsigned char *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+static inline uint64_t Round(uint64_t acc, uint64_t input)
+{
+    acc += input * prime2;
+    acc = Rotl(acc, 31);
+    return acc * prime1;
+}
+
+static inline uint64_t MergeRound(uint64_t acc, uint64_t val)
+{
+    acc ^= Round(0, val);
+    return acc * prime1 + prime4;
+}
+
+uint64_t Hash64(const void *data, size_t size, uint64_t seed)
+{
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    const unsigned char *end = p + size;
+    uint64_t h;
+    if (size >= 32)
+    {
+        //four independent lanes over 32 byte stripes
+        uint64_t v1 = seed + prime1 + prime2, v2 = seed + prime2, v3 = seed, v4 = seed - prime1;
+        const unsigned char *limit = end - 32;
+        do
+        {
+            v1 = Round(v1, Read64(p));
+            v2 = Round(v2, Read64(p + 8));
+            v3 = Round(v3, Read64(p + 16));
+            v4 = Round(v4, Read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        h = Rotl(v1, 1) + Rotl(v2, 7) + Rotl(v3, 12) + Rotl(v4, 18);
+        h = MergeRound(h, v1);
+        h = MergeRound(h, v2);
+        h = MergeRound(h, v3);
+        h = MergeRound(h, v4);
+    }
+    else
+    {
+        h = seed + prime5;
+    }
+    h += size;
+
+    for (; p + 8 <= end; p += 8)
+    {
+        h ^= Round(0, Read64(p));
+        h = Rotl(h, 27) * prime1 + prime4;
+    }
+    if (p + 4 <= end)
+    {
+        h ^= Read32(p) * prime1;
+        h = Rotl(h, 23) * prime2 + prime3;
+        p += 4;
+    }
+    for (; p < end; p++)
+    {
+        h ^= *p * prime5;
+        h = Rotl(h, 11) * prime1;
+    }
+
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    h *= prime3;
+    h ^= h >> 32;
+    return h;
+}
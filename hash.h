@@ -0,0 +1,10 @@
+#ifndef _HASH_H
+#define _HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+//XXH64 of data; matches the reference xxHash for the same seed
+uint64_t Hash64(const void *data, size_t size, uint64_t seed = 0);
+
+#endif // _HASH_H
@@ -0,0 +1,209 @@
+/*
+soundextract
+Copyright 2018 Jonathan wilson
+Copyright 2020 Sławomir Śpiewak
+
+Soundextract is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version. See the file COPYING for more details.
+*/
+
+//whole-directory import: parallel discovery, then parallel XML parsing
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include "catalog.h"
+#include "importdir.h"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+//directories still to be listed. A walker that finds the queue empty waits
+//while others are busy, since they may still push subdirectories.
+struct DirQueue
+{
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<fs::path> pending;
+    size_t busy = 0;
+
+    bool Pop(fs::path &dir)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [this]()
+        {
+            return !pending.empty() || busy == 0;
+        });
+        if (pending.empty())
+        {
+            return false;
+        }
+        dir = std::move(pending.back());
+        pending.pop_back();
+        busy++;
+        return true;
+    }
+
+    //the directory last popped is listed; these are its subdirectories
+    void Done(std::vector<fs::path> &subdirs)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        busy--;
+        for (auto &dir : subdirs)
+        {
+            pending.push_back(std::move(dir));
+        }
+        subdirs.clear();
+        wake.notify_all();
+    }
+};
+
+//files one walker found, merged once it runs out of directories
+struct Found
+{
+    std::vector<std::string> xmls;
+    std::vector<std::string> banks;
+    WemSet wems;
+};
+}
+
+static std::string LowerExtension(const fs::path &path)
+{
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c)
+    {
+        return static_cast<char>(tolower(c));
+    });
+    return ext;
+}
+
+//one readdir pass; the entry types come with it, so nothing is stat'ed
+static void ListDirectory(const fs::path &dir, Found &found, std::vector<fs::path> &subdirs)
+{
+    std::error_code ec;
+    std::string dirName = dir.generic_string();
+    for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec))
+    {
+        const fs::directory_entry &entry = *it;
+        std::error_code typeError;
+        //symlinked directories are skipped, they can loop
+        if (entry.is_directory(typeError) && !entry.is_symlink(typeError))
+        {
+            subdirs.push_back(entry.path());
+            continue;
+        }
+        std::string ext = LowerExtension(entry.path());
+        if (ext == ".wem")
+        {
+            found.wems[dirName].insert(entry.path().stem().string());
+        }
+        else if (ext == ".xml")
+        {
+            found.xmls.push_back(entry.path().generic_string());
+        }
+        else if (ext == ".bnk")
+        {
+            found.banks.push_back(entry.path().generic_string());
+        }
+    }
+}
+
+bool ImportDirectory(const std::string &root, GameAudio &game, const std::string &cacheDir, unsigned int jobs)
+{
+    game = GameAudio();
+    std::error_code ec;
+    fs::path rootPath = fs::absolute(root, ec).lexically_normal();
+    if (ec || !fs::is_directory(rootPath, ec))
+    {
+        return false;
+    }
+    //a trailing separator leaves an empty file name, and then paths that don't match WemPath
+    if (rootPath.filename().empty())
+    {
+        rootPath = rootPath.parent_path();
+    }
+    if (jobs == 0)
+    {
+        jobs = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    DirQueue queue;
+    queue.pending.push_back(rootPath);
+    std::mutex mergeMutex;
+    auto walker = [&]()
+    {
+        Found found;
+        std::vector<fs::path> subdirs;
+        fs::path dir;
+        while (queue.Pop(dir))
+        {
+            ListDirectory(dir, found, subdirs);
+            queue.Done(subdirs);
+        }
+        std::lock_guard<std::mutex> lock(mergeMutex);
+        game.xmls.insert(game.xmls.end(), found.xmls.begin(), found.xmls.end());
+        game.banks.insert(game.banks.end(), found.banks.begin(), found.banks.end());
+        for (auto &dir : found.wems)
+        {
+            auto &ids = game.wems[dir.first];
+            if (ids.empty())
+                ids.swap(dir.second);
+            else
+                ids.insert(dir.second.begin(), dir.second.end());
+        }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < jobs; i++)
+    {
+        threads.emplace_back(walker);
+    }
+    walker();
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    threads.clear();
+    std::sort(game.xmls.begin(), game.xmls.end());
+    std::sort(game.banks.begin(), game.banks.end());
+
+    //each LoadSoundbanksInfo call parses with its own XMLDocument
+    std::vector<std::vector<Sound>> perXml(game.xmls.size());
+    std::vector<char> isSoundbanksInfo(game.xmls.size(), 0);
+    std::atomic<size_t> next(0);
+    auto parser = [&]()
+    {
+        for (size_t i = next++; i < game.xmls.size(); i = next++)
+        {
+            isSoundbanksInfo[i] = LoadSoundbanksInfo(game.xmls[i], perXml[i], cacheDir, &game.wems);
+        }
+    };
+    size_t parsers = std::min<size_t>(jobs, game.xmls.size());
+    for (size_t i = 1; i < parsers; i++)
+    {
+        threads.emplace_back(parser);
+    }
+    parser();
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    size_t total = 0;
+    for (const auto &sounds : perXml)
+    {
+        total += sounds.size();
+    }
+    game.sounds.reserve(total);
+    for (size_t i = 0; i < perXml.size(); i++)
+    {
+        game.soundbanksInfos += isSoundbanksInfo[i];
+        game.sounds.insert(game.sounds.end(), std::make_move_iterator(perXml[i].begin()), std::make_move_iterator(perXml[i].end()));
+    }
+    return true;
+}
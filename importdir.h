@@ -0,0 +1,54 @@
+#ifndef _IMPORTDIR_H
+#define _IMPORTDIR_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include "soundbank.h"
+
+//everything a game's audio tree holds
+struct GameAudio
+{
+    std::vector<std::string> xmls;      //every .xml found, sorted
+    std::vector<std::string> banks;     //every .bnk found, sorted
+    WemSet wems;                        //every .wem found
+    //sounds of the XMLs that are SoundbanksInfo files, in xmls order, each
+    //file's sorted by name; streamed ones without a .wem already dropped
+    std::vector<Sound> sounds;
+    size_t soundbanksInfos = 0;         //how many of the xmls those were
+};
+
+//walk root on `jobs` threads (0 for hardware concurrency), each listing
+//directories off a shared queue, then parse the XMLs on as many threads
+//through the catalog cache in cacheDir (empty for none). Paths come out
+//absolute. false if root can't be listed.
+bool ImportDirectory(const std::string &root, GameAudio &game, const std::string &cacheDir, unsigned int jobs = 0);
+
+//an import to run on another thread and poll until it's finished
+class ImportJob
+{
+public:
+    ImportJob(const std::string &root, const std::string &cacheDir) : root(root), cacheDir(cacheDir) {}
+    ImportJob(const ImportJob &) = delete;
+    ImportJob &operator=(const ImportJob &) = delete;
+
+    //import on the calling thread; run a job only once
+    void Run()
+    {
+        ok = ImportDirectory(root, game, cacheDir);
+        finished.store(true, std::memory_order_release);
+    }
+    bool Finished() const { return finished.load(std::memory_order_acquire); }
+    //what ImportDirectory returned and what it found, once Finished
+    bool Ok() const { return ok; }
+    GameAudio &Game() { return game; }
+
+private:
+    std::string root;
+    std::string cacheDir;
+    GameAudio game;
+    bool ok = false;
+    std::atomic<bool> finished{false};
+};
+
+#endif // _IMPORTDIR_H
@@ -0,0 +1,176 @@
+/*
+soundextract
+Copyright 2018 Jonathan wilson
+Copyright 2020 Sławomir Śpiewak
+
+Soundextract is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version. See the file COPYING for more details.
+*/
+
+//batched I/O throughput: soundextract-iobench <dir of .wem files> <scratch output dir> [depth] [repeats]
+//reads every .wem under the directory and writes copies through io_uring
+//and through stdio, each into its own subdirectory. An untimed pass warms
+//the page cache and creates the output files first; then each path runs
+//repeats times, alternating which goes first, and the best and median
+//times are reported. The numbers are for a warm cache; drop caches and
+//pass a repeat count of 1 for a rough cold one.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+#include "fileio.h"
+
+namespace fs = std::filesystem;
+
+typedef std::chrono::steady_clock Clock;
+
+static double Seconds(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+struct IOPath
+{
+    const char *name;
+    std::unique_ptr<BatchIO> io;
+    fs::path outDir;
+    std::vector<double> readTimes;
+    std::vector<double> writeTimes;
+    size_t failed = 0;
+};
+
+//reads every path and writes it back out, checking the bytes against the
+//reference when there is one
+static bool Pass(IOPath &path, const std::vector<std::string> &paths, std::vector<std::vector<char>> &reference, size_t &bytes)
+{
+    std::vector<FileRead> reads(paths.size());
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        reads[i].path = paths[i];
+    }
+    Clock::time_point start = Clock::now();
+    path.io->ReadFiles(reads);
+    path.readTimes.push_back(Seconds(start));
+
+    bytes = 0;
+    for (size_t i = 0; i < reads.size(); i++)
+    {
+        bytes += reads[i].data.size();
+        path.failed += !reads[i].ok;
+        if (reference.size() < reads.size())
+        {
+            reference.push_back(reads[i].data);
+        }
+        else if (reads[i].data != reference[i])
+        {
+            fprintf(stderr, "%s: %s read different contents\n", paths[i].c_str(), path.name);
+            return false;
+        }
+    }
+
+    std::vector<FileWrite> writes(paths.size());
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        writes[i].path = (path.outDir / (std::to_string(i) + ".wem")).string();
+        writes[i].data = &reads[i].data;
+    }
+    start = Clock::now();
+    path.io->WriteFiles(writes);
+    path.writeTimes.push_back(Seconds(start));
+    for (const auto &write : writes)
+    {
+        path.failed += !write.ok;
+    }
+    return true;
+}
+
+static double Median(std::vector<double> times)
+{
+    std::sort(times.begin(), times.end());
+    size_t middle = times.size() / 2;
+    return times.size() % 2 ? times[middle] : (times[middle - 1] + times[middle]) / 2;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "usage: %s <dir of .wem files> <scratch output dir> [depth] [repeats]\n", argv[0]);
+        return 1;
+    }
+    unsigned int depth = argc > 3 ? static_cast<unsigned int>(atoi(argv[3])) : 64;
+    int repeats = argc > 4 ? std::max(atoi(argv[4]), 1) : 5;
+
+    std::vector<std::string> paths;
+    std::error_code ec;
+    for (fs::recursive_directory_iterator it(argv[1], ec), end; it != end; it.increment(ec))
+    {
+        if (it->is_regular_file(ec) && it->path().extension() == ".wem")
+        {
+            paths.push_back(it->path().string());
+        }
+    }
+    if (paths.empty())
+    {
+        fprintf(stderr, "%s: no .wem files\n", argv[1]);
+        return 1;
+    }
+
+    std::vector<IOPath> ioPaths;
+    for (int useRing = 1; useRing >= 0; useRing--)
+    {
+        IOPath path;
+        path.name = useRing ? "io_uring" : "stdio";
+        path.io.reset(new BatchIO(depth, useRing != 0));
+        path.outDir = fs::path(argv[2]) / path.name;
+        if (useRing && !path.io->UsingRing())
+        {
+            printf("io_uring      unavailable, skipped\n");
+            continue;
+        }
+        ioPaths.push_back(std::move(path));
+    }
+
+    printf("%zu files, depth %u, %d runs per path after a warm-up\n", paths.size(), depth, repeats);
+    std::vector<std::vector<char>> reference;
+    size_t bytes = 0;
+    for (auto &path : ioPaths)
+    {
+        if (!Pass(path, paths, reference, bytes))
+        {
+            return 1;
+        }
+        path.readTimes.clear();
+        path.writeTimes.clear();
+    }
+    for (int run = 0; run < repeats; run++)
+    {
+        for (size_t i = 0; i < ioPaths.size(); i++)
+        {
+            IOPath &path = ioPaths[run % 2 ? ioPaths.size() - 1 - i : i];
+            if (!Pass(path, paths, reference, bytes))
+            {
+                return 1;
+            }
+        }
+    }
+
+    for (const auto &path : ioPaths)
+    {
+        double read = Median(path.readTimes), write = Median(path.writeTimes);
+        double bestRead = *std::min_element(path.readTimes.begin(), path.readTimes.end());
+        double bestWrite = *std::min_element(path.writeTimes.begin(), path.writeTimes.end());
+        printf("%-12s  read %8.0f files/s %7.1f MB/s (best %8.0f)   write %8.0f files/s %7.1f MB/s (best %8.0f)%s\n",
+            path.name,
+            paths.size() / read, bytes / read / 1e6, paths.size() / bestRead,
+            paths.size() / write, bytes / write / 1e6, paths.size() / bestWrite,
+            path.failed ? "   (some failed)" : "");
+    }
+    return 0;
+}
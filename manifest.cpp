@@ -0,0 +1,128 @@
+/*
+soundextract
+Copyright 2018 Jonathan wilson
+Copyright 2020 Sławomir Śpiewak
+
+Soundextract is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version. See the file COPYING for more details.
+*/
+
+//export manifest: a text file in the export directory, a header line and
+//then one tab separated line per output file:
+//path, media id, input hash, converter, output size
+//Version 1 manifests also had an output hash before the size; nothing
+//checked it, and it's skipped when one is loaded.
+#include <cinttypes>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include "manifest.h"
+
+namespace fs = std::filesystem;
+
+static const char manifestName[] = "soundextract.manifest";
+static const char manifestHeader[] = "soundextract manifest 2";
+static const char manifestHeader1[] = "soundextract manifest 1";
+
+void ExportManifest::Load(const std::string &dir)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    dirExport = dir;
+    entries.clear();
+    std::ifstream in(fs::path(dir) / manifestName);
+    std::string line;
+    if (!std::getline(in, line) || (line != manifestHeader && line != manifestHeader1))
+    {
+        return;
+    }
+    bool version1 = line == manifestHeader1;
+    while (std::getline(in, line))
+    {
+        std::istringstream fields(line);
+        std::string path, inputHash, outputHash, outputSize;
+        ManifestEntry entry;
+        if (!std::getline(fields, path, '\t') || !std::getline(fields, entry.mediaId, '\t') || !std::getline(fields, inputHash, '\t') ||
+            !std::getline(fields, entry.converter, '\t') || (version1 && !std::getline(fields, outputHash, '\t')) || !std::getline(fields, outputSize))
+        {
+            continue;
+        }
+        entry.inputHash = strtoull(inputHash.c_str(), nullptr, 16);
+        entry.outputSize = strtoull(outputSize.c_str(), nullptr, 10);
+        entries[path] = entry;
+    }
+}
+
+bool ExportManifest::Save() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::error_code ec;
+    fs::create_directories(dirExport, ec);
+    //written aside and renamed over, so an interrupted save leaves the old one
+    fs::path path = fs::path(dirExport) / manifestName;
+    fs::path temp = path;
+    temp += ".tmp";
+    FILE *out = fopen(temp.string().c_str(), "wb");
+    if (!out)
+    {
+        return false;
+    }
+    fprintf(out, "%s\n", manifestHeader);
+    for (const auto &entry : entries)
+    {
+        //a tab or newline in a name would break the line apart; such files are just redone
+        if (entry.first.find_first_of("\t\n") != std::string::npos || entry.second.mediaId.find_first_of("\t\n") != std::string::npos)
+        {
+            continue;
+        }
+        fprintf(out, "%s\t%s\t%016" PRIx64 "\t%s\t%" PRIu64 "\n", entry.first.c_str(), entry.second.mediaId.c_str(), entry.second.inputHash,
+            entry.second.converter.c_str(), entry.second.outputSize);
+    }
+    if (fclose(out) != 0)
+    {
+        fs::remove(temp, ec);
+        return false;
+    }
+    fs::rename(temp, path, ec);
+    return !ec;
+}
+
+std::string ExportManifest::Key(const std::string &fileName) const
+{
+    return fs::path(fileName).lexically_relative(dirExport).generic_string();
+}
+
+bool ExportManifest::UpToDate(const std::string &fileName, const ManifestEntry &current) const
+{
+    std::string key = Key(fileName);
+    uint64_t outputSize;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(key);
+        if (it == entries.end() || it->second.mediaId != current.mediaId || it->second.inputHash != current.inputHash ||
+            it->second.converter != current.converter)
+        {
+            return false;
+        }
+        outputSize = it->second.outputSize;
+    }
+    std::error_code ec;
+    uint64_t size = fs::file_size(fileName, ec);
+    return !ec && size == outputSize;
+}
+
+void ExportManifest::Record(const std::string &fileName, const ManifestEntry &entry)
+{
+    std::string key = Key(fileName);
+    std::lock_guard<std::mutex> lock(mutex);
+    entries[key] = entry;
+}
+
+void ExportManifest::Forget(const std::string &fileName)
+{
+    std::string key = Key(fileName);
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.erase(key);
+}
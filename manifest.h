@@ -0,0 +1,44 @@
+#ifndef _MANIFEST_H
+#define _MANIFEST_H
+
+#include <stdint.h>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+//what an export run wrote to one output file and what it was made from
+struct ManifestEntry
+{
+    std::string mediaId;
+    uint64_t inputHash = 0;         //Hash64 of the wem
+    std::string converter;          //ConverterVersion() of the run
+    uint64_t outputSize = 0;        //size on disk, after any revorb pass
+};
+
+//the manifest an export directory keeps of its files, so a later run can
+//skip sounds whose wem and converter haven't changed. Record and Forget may
+//be called from several threads.
+class ExportManifest
+{
+public:
+    //read dirExport's manifest; a missing or malformed one loads empty
+    void Load(const std::string &dirExport);
+    //replace the manifest file with the current entries
+    bool Save() const;
+
+    //true when fileName was written from the same input by the same
+    //converter and is still there at the size it was written
+    bool UpToDate(const std::string &fileName, const ManifestEntry &current) const;
+    void Record(const std::string &fileName, const ManifestEntry &entry);
+    void Forget(const std::string &fileName);
+
+private:
+    //manifest keys are paths relative to the export directory
+    std::string Key(const std::string &fileName) const;
+
+    std::string dirExport;
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, ManifestEntry> entries;
+};
+
+#endif // _MANIFEST_H
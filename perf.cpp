@@ -0,0 +1,136 @@
+/*
+soundextract
+Copyright 2018 Jonathan wilson
+Copyright 2020 Sławomir Śpiewak
+
+Soundextract is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version. See the file COPYING for more details.
+*/
+
+//per-stage timers and counters, summed over threads for a report
+#include "perf.h"
+
+#ifdef SOUNDEXTRACT_PERF_COUNTERS
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+const char *const stageNames[] = {
+    "load_bank", "parse_xml", "read_files", "convert", "decode", "setup", "audio_packets", "revorb", "write_files"
+};
+const char *const counterNames[] = {
+    "bytes_read", "bytes_written", "packets", "pages", "codebooks_rebuilt", "codebooks_copied",
+    "setup_cache_hits", "setup_cache_misses", "catalog_cache_hits", "catalog_cache_misses"
+};
+static_assert(sizeof(stageNames) / sizeof(stageNames[0]) == static_cast<size_t>(PerfStage::Count), "a stage has no name");
+static_assert(sizeof(counterNames) / sizeof(counterNames[0]) == static_cast<size_t>(PerfCounter::Count), "a counter has no name");
+
+std::mutex blockMutex;
+std::vector<std::unique_ptr<PerfBlock>> blocks;
+std::vector<PerfBlock *> idleBlocks;
+
+//gives the thread's block back when the thread exits
+struct PerfRelease
+{
+    PerfBlock *block = nullptr;
+    ~PerfRelease()
+    {
+        std::lock_guard<std::mutex> lock(blockMutex);
+        idleBlocks.push_back(block);
+    }
+};
+
+thread_local PerfRelease release;
+
+struct PerfTotals
+{
+    uint64_t nanoseconds[static_cast<size_t>(PerfStage::Count)] = {};
+    uint64_t calls[static_cast<size_t>(PerfStage::Count)] = {};
+    uint64_t counters[static_cast<size_t>(PerfCounter::Count)] = {};
+};
+
+PerfTotals Sum()
+{
+    PerfTotals totals;
+    std::lock_guard<std::mutex> lock(blockMutex);
+    for (const auto &block : blocks)
+    {
+        for (size_t i = 0; i < static_cast<size_t>(PerfStage::Count); i++)
+        {
+            totals.nanoseconds[i] += block->nanoseconds[i].load(std::memory_order_relaxed);
+            totals.calls[i] += block->calls[i].load(std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < static_cast<size_t>(PerfCounter::Count); i++)
+            totals.counters[i] += block->counters[i].load(std::memory_order_relaxed);
+    }
+    return totals;
+}
+}
+
+PerfBlock *RegisterPerfThread()
+{
+    std::lock_guard<std::mutex> lock(blockMutex);
+    if (!idleBlocks.empty())
+    {
+        release.block = idleBlocks.back();
+        idleBlocks.pop_back();
+    }
+    else
+    {
+        blocks.emplace_back(new PerfBlock);
+        release.block = blocks.back().get();
+    }
+    return release.block;
+}
+
+void PerfReport(FILE *out, bool json)
+{
+    PerfTotals totals = Sum();
+    if (json)
+    {
+        fprintf(out, "{\n  \"stages\": {\n");
+        for (size_t i = 0; i < static_cast<size_t>(PerfStage::Count); i++)
+        {
+            fprintf(out, "    \"%s\": {\"calls\": %llu, \"seconds\": %.6f}%s\n", stageNames[i], static_cast<unsigned long long>(totals.calls[i]),
+                totals.nanoseconds[i] / 1e9, i + 1 < static_cast<size_t>(PerfStage::Count) ? "," : "");
+        }
+        fprintf(out, "  },\n  \"counters\": {\n");
+        for (size_t i = 0; i < static_cast<size_t>(PerfCounter::Count); i++)
+        {
+            fprintf(out, "    \"%s\": %llu%s\n", counterNames[i], static_cast<unsigned long long>(totals.counters[i]),
+                i + 1 < static_cast<size_t>(PerfCounter::Count) ? "," : "");
+        }
+        fprintf(out, "  }\n}\n");
+        return;
+    }
+    fprintf(out, "%-22s %10s %12s   (summed over threads)\n", "stage", "calls", "seconds");
+    for (size_t i = 0; i < static_cast<size_t>(PerfStage::Count); i++)
+    {
+        fprintf(out, "%-22s %10llu %12.6f\n", stageNames[i], static_cast<unsigned long long>(totals.calls[i]), totals.nanoseconds[i] / 1e9);
+    }
+    fprintf(out, "%-22s %10s\n", "counter", "value");
+    for (size_t i = 0; i < static_cast<size_t>(PerfCounter::Count); i++)
+    {
+        fprintf(out, "%-22s %10llu\n", counterNames[i], static_cast<unsigned long long>(totals.counters[i]));
+    }
+}
+
+void PerfReset()
+{
+    std::lock_guard<std::mutex> lock(blockMutex);
+    for (const auto &block : blocks)
+    {
+        for (auto &total : block->nanoseconds)
+            total.store(0, std::memory_order_relaxed);
+        for (auto &total : block->calls)
+            total.store(0, std::memory_order_relaxed);
+        for (auto &total : block->counters)
+            total.store(0, std::memory_order_relaxed);
+    }
+}
+
+#endif // SOUNDEXTRACT_PERF_COUNTERS
@@ -0,0 +1,111 @@
+#ifndef _PERF_H
+#define _PERF_H
+
+//per-stage timers and event counters for finding where a run spends its
+//time. They're only built with SOUNDEXTRACT_PERF_COUNTERS defined (the
+//CMake option of the same name); otherwise PERF_TIME and PERF_COUNT expand
+//to nothing and none of this exists.
+#ifdef SOUNDEXTRACT_PERF_COUNTERS
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+//timed stages. Times are inclusive and summed over threads, so a stage
+//nested in another (setup inside convert) counts towards both.
+enum class PerfStage
+{
+    LoadBank,       //mapping and indexing a bank
+    ParseXml,       //SoundbanksInfo parsing, catalog cache misses only
+    ReadFiles,      //streamed wems
+    Convert,        //one sound from wem to output bytes
+    Decode,         //ADPCM and Vorbis to PCM
+    Setup,          //Vorbis header packets, codebooks included
+    AudioPackets,   //Vorbis audio packets copied into pages
+    Revorb,
+    WriteFiles,
+    Count
+};
+
+enum class PerfCounter
+{
+    BytesRead,          //banks mapped and streamed wems read
+    BytesWritten,
+    Packets,            //Vorbis audio packets
+    Pages,              //Ogg pages, not counting packets handed to a sink
+    CodebooksRebuilt,
+    CodebooksCopied,    //full setups whose codebooks only need copying
+    SetupCacheHits,
+    SetupCacheMisses,
+    CatalogCacheHits,
+    CatalogCacheMisses,
+    Count
+};
+
+//one thread's totals. Only that thread writes them, so it doesn't need
+//locked adds; a report may read them from anywhere at any time.
+struct PerfBlock
+{
+    std::atomic<uint64_t> nanoseconds[static_cast<size_t>(PerfStage::Count)]{};
+    std::atomic<uint64_t> calls[static_cast<size_t>(PerfStage::Count)]{};
+    std::atomic<uint64_t> counters[static_cast<size_t>(PerfCounter::Count)]{};
+};
+
+//the calling thread's block; blocks of finished threads are handed to new
+//ones with their totals kept
+PerfBlock *RegisterPerfThread();
+
+inline thread_local PerfBlock *perfBlock = nullptr;
+
+inline PerfBlock &ThreadPerfBlock()
+{
+    if (!perfBlock)
+        perfBlock = RegisterPerfThread();
+    return *perfBlock;
+}
+
+inline void PerfAdd(std::atomic<uint64_t> &total, uint64_t n)
+{
+    total.store(total.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+//adds its lifetime to a stage
+class PerfTimer
+{
+public:
+    explicit PerfTimer(PerfStage stage) : stage(static_cast<size_t>(stage)), start(std::chrono::steady_clock::now()) {}
+    PerfTimer(const PerfTimer &) = delete;
+    PerfTimer &operator=(const PerfTimer &) = delete;
+    ~PerfTimer()
+    {
+        PerfBlock &block = ThreadPerfBlock();
+        PerfAdd(block.nanoseconds[stage], static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()));
+        PerfAdd(block.calls[stage], 1);
+    }
+
+private:
+    size_t stage;
+    std::chrono::steady_clock::time_point start;
+};
+
+//totals over every thread so far, as a table or as one JSON object
+void PerfReport(FILE *out, bool json);
+//zero the totals; counts from threads still running may be lost
+void PerfReset();
+
+#define PERF_JOIN2(a, b) a##b
+#define PERF_JOIN(a, b) PERF_JOIN2(a, b)
+//time the rest of the enclosing scope as a stage
+#define PERF_TIME(stage) PerfTimer PERF_JOIN(perfTimer, __LINE__)(PerfStage::stage)
+#define PERF_COUNT(counter, n) PerfAdd(ThreadPerfBlock().counters[static_cast<size_t>(PerfCounter::counter)], static_cast<uint64_t>(n))
+
+#else
+
+#define PERF_TIME(stage) ((void)0)
+#define PERF_COUNT(counter, n) ((void)0)
+
+#endif // SOUNDEXTRACT_PERF_COUNTERS
+
+#endif // _PERF_H
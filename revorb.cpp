@@ -132,13 +132,9 @@ int revorb(const char *fname)
     }
 
     char tmpName[400];
-	fprintf(stderr, "%s\n", fname);
-
     strcpy(tmpName, fname);
     strcat(tmpName, ".tmp");
 
-    fprintf(stderr, "%s\n", tmpName);
-
     FILE *fo = fopen(tmpName, "wb");
     if (!fo) {
         fprintf(stderr, "Could not open output file.\n");
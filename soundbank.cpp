@@ -0,0 +1,465 @@
+/*
+soundextract
+Copyright 2018 Jonathan wilson
+Copyright 2020 Sławomir Śpiewak
+
+Soundextract is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version. See the file COPYING for more details.
+*/
+
+//bank and SoundbanksInfo parsing, shared by the GUI and the command line tool
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+#include "tinyxml2.h"
+#include "perf.h"
+#include "soundbank.h"
+
+namespace fs = std::filesystem;
+
+SoundBank::~SoundBank()
+{
+    UnloadBank(*this);
+}
+
+void UnloadBank(SoundBank &bank)
+{
+    UnmapFile(bank.mapping, bank.mappingSize);
+    bank.mapping = nullptr;
+    bank.mappingSize = 0;
+    bank.data = nullptr;
+    bank.dataSize = 0;
+    bank.media.clear();
+    bank.media.shrink_to_fit();
+}
+
+void *MapFile(const std::string &fname, size_t &size)
+{
+    void *view = nullptr;
+    size = 0;
+#ifdef _WIN32
+    HANDLE file = CreateFileA(fname.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return nullptr;
+    }
+    LARGE_INTEGER fileSize;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+    {
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping)
+        {
+            //the view keeps the mapping object alive
+            view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+            size = static_cast<size_t>(fileSize.QuadPart);
+        }
+    }
+    CloseHandle(file);
+#else
+    int fd = open(fname.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        view = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view == MAP_FAILED)
+        {
+            view = nullptr;
+        }
+        else
+        {
+            size = static_cast<size_t>(st.st_size);
+        }
+    }
+    close(fd);
+#endif
+    return view;
+}
+
+void UnmapFile(void *view, size_t size)
+{
+    if (view)
+    {
+#ifdef _WIN32
+        (void)size;
+        UnmapViewOfFile(view);
+#else
+        munmap(view, size);
+#endif
+    }
+}
+
+bool LoadBank(const std::string &fname, SoundBank &bank)
+{
+    PERF_TIME(LoadBank);
+    UnloadBank(bank);
+    bank.path = fname;
+    bank.mapping = MapFile(fname, bank.mappingSize);
+    if (!bank.mapping)
+    {
+        return false;
+    }
+    PERF_COUNT(BytesRead, bank.mappingSize);
+    const char *file = static_cast<const char *>(bank.mapping);
+    const char *end = file + bank.mappingSize;
+    const char *ptr = file;
+
+    SubchunkHeader sc;
+    if (ptr + sizeof(sc) > end)
+    {
+        return true;
+    }
+    memcpy(&sc, ptr, sizeof(sc));
+    if (sc.dwTag != BankHeaderChunkID)
+    {
+        return true;
+    }
+    ptr += sizeof(sc) + sc.dwChunkSize;
+    while (ptr + sizeof(sc) <= end)
+    {
+        memcpy(&sc, ptr, sizeof(sc));
+        ptr += sizeof(sc);
+        size_t chunkSize = std::min<size_t>(sc.dwChunkSize, end - ptr);
+        switch (sc.dwTag)
+        {
+        case BankDataIndexChunkID:
+            bank.media.resize(chunkSize / sizeof(MediaHeader));
+            memcpy(bank.media.data(), ptr, bank.media.size() * sizeof(MediaHeader));
+            break;
+        case BankDataChunkID:
+            //no copy, converters read straight out of the mapping
+            bank.data = ptr;
+            bank.dataSize = chunkSize;
+            break;
+        default:
+            break;
+        }
+        ptr += chunkSize;
+    }
+    return true;
+}
+
+void AdviseBank(const SoundBank &bank, BankAccess access)
+{
+#ifndef _WIN32
+    if (!bank.mapping)
+    {
+        return;
+    }
+    if (access == BankAccess::Sequential)
+    {
+        madvise(bank.mapping, bank.mappingSize, MADV_SEQUENTIAL);
+        madvise(bank.mapping, bank.mappingSize, MADV_WILLNEED);
+    }
+    else
+    {
+        madvise(bank.mapping, bank.mappingSize, MADV_RANDOM);
+    }
+#else
+    (void)bank;
+    (void)access;
+#endif
+}
+
+static inline size_t HashMediaID(MediaID id, size_t mask)
+{
+    //the murmur3 finaliser, so ids that only differ in their high bits (or
+    //run consecutively) don't pile up in the low bits the mask keeps
+    UInt32 h = id;
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return static_cast<size_t>(h) & mask;
+}
+
+bool MediaIndex::AddBank(const std::string &fname)
+{
+    if (FindBank(fname))
+    {
+        return true;
+    }
+    std::shared_ptr<SoundBank> bank = std::make_shared<SoundBank>();
+    if (!LoadBank(fname, *bank))
+    {
+        return false;
+    }
+    UInt32 bankIndex = static_cast<UInt32>(banks.size());
+    for (const auto &m : bank->media)
+    {
+        //entries pointing past DATA can't be extracted anyway
+        if (static_cast<size_t>(m.uOffset) + m.uSize > bank->dataSize)
+        {
+            continue;
+        }
+        Insert(Location{m.id, bankIndex, m.uOffset, m.uSize});
+    }
+    bankByPath.emplace(fname, banks.size());
+    banks.push_back(std::move(bank));
+    return true;
+}
+
+void MediaIndex::Grow()
+{
+    std::vector<Location> old;
+    old.swap(table);
+    table.assign(old.empty() ? 64 : old.size() * 2, Location{0, InvalidBank, 0, 0});
+    count = 0;
+    for (const auto &location : old)
+    {
+        if (location.bank != InvalidBank)
+        {
+            Insert(location);
+        }
+    }
+}
+
+void MediaIndex::Insert(const Location &location)
+{
+    //keep the load factor at or below one half
+    if ((count + 1) * 2 > table.size())
+    {
+        Grow();
+    }
+    size_t mask = table.size() - 1;
+    for (size_t i = HashMediaID(location.id, mask);; i = (i + 1) & mask)
+    {
+        if (table[i].bank == InvalidBank)
+        {
+            table[i] = location;
+            count++;
+            return;
+        }
+        if (table[i].id == location.id)
+        {
+            return;
+        }
+    }
+}
+
+const MediaIndex::Location *MediaIndex::Find(MediaID id) const
+{
+    if (table.empty())
+    {
+        return nullptr;
+    }
+    size_t mask = table.size() - 1;
+    for (size_t i = HashMediaID(id, mask);; i = (i + 1) & mask)
+    {
+        if (table[i].bank == InvalidBank)
+        {
+            return nullptr;
+        }
+        if (table[i].id == id)
+        {
+            return &table[i];
+        }
+    }
+}
+
+const char *MediaIndex::FindMedia(MediaID id, UInt32 &size) const
+{
+    const Location *location = Find(id);
+    if (!location)
+    {
+        return nullptr;
+    }
+    size = location->uSize;
+    return banks[location->bank]->data + location->uOffset;
+}
+
+const SoundBank *MediaIndex::FindBank(const std::string &fname) const
+{
+    return ShareBank(fname).get();
+}
+
+std::shared_ptr<const SoundBank> MediaIndex::ShareBank(const std::string &fname) const
+{
+    auto found = bankByPath.find(fname);
+    if (found == bankByPath.end())
+    {
+        return nullptr;
+    }
+    return banks[found->second];
+}
+
+bool ParseMediaID(const std::string &text, MediaID &id)
+{
+    const char *end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, id);
+    return !text.empty() && result.ec == std::errc() && result.ptr == end;
+}
+
+void SortByBankOffset(const MediaIndex &index, std::vector<Sound> &sounds)
+{
+    //streamed sounds don't touch the bank, keep them first in their old order
+    auto offset = [&index](const Sound &s) -> size_t
+    {
+        if (s.streamed)
+        {
+            return 0;
+        }
+        MediaID id;
+        if (!ParseMediaID(s.id, id))
+        {
+            return 0;
+        }
+        const MediaIndex::Location *location = index.Find(id);
+        return location ? static_cast<size_t>(location->uOffset) + 1 : 0;
+    };
+    std::vector<std::pair<size_t, Sound>> keyed;
+    keyed.reserve(sounds.size());
+    for (auto &sound : sounds)
+    {
+        keyed.emplace_back(offset(sound), std::move(sound));
+    }
+    std::stable_sort(keyed.begin(), keyed.end(), [](const std::pair<size_t, Sound> &a, const std::pair<size_t, Sound> &b)
+    {
+        return a.first < b.first;
+    });
+    for (size_t i = 0; i < keyed.size(); i++)
+    {
+        sounds[i] = std::move(keyed[i].second);
+    }
+}
+
+std::string WemPath(const Sound &sound)
+{
+    return fs::path(sound.bankPath).parent_path().generic_string();
+}
+
+std::string WemFileName(const Sound &sound)
+{
+    return WemPath(sound) + "/" + sound.id + ".wem";
+}
+
+static void ParseFiles(tinyxml2::XMLNode *xml, bool streamed, std::vector<Sound> &sounds)
+{
+    for (xml = xml->FirstChildElement("File");xml;xml = xml->NextSiblingElement("File"))
+    {
+        Sound sound;
+        tinyxml2::XMLNode * pPrefetchSize = xml->FirstChildElement("PrefetchSize");
+        if (pPrefetchSize!=nullptr) {
+            continue; //this file might be abnormally cut, just don't parse it further
+        }
+        sound.streamed = streamed;
+        sound.id = xml->ToElement()->Attribute("Id");
+        xml = xml->FirstChildElement("ShortName");
+        sound.name = xml->FirstChild()->ToText()->Value();
+        if (sound.name.rfind('.') != std::string::npos)
+            sound.name.erase(sound.name.rfind('.'));
+        xml = xml->Parent();
+        xml = xml->FirstChildElement("Path");
+        //paths in the XML use Windows separators
+        std::string soundPath = xml->FirstChild()->ToText()->Value();
+        std::replace(soundPath.begin(), soundPath.end(), '\\', '/');
+        sound.relativePath = fs::path(soundPath).parent_path().generic_string();
+        if (sound.relativePath.empty())
+            sound.relativePath = ".";
+        xml = xml->Parent();
+
+
+        sounds.push_back(sound);
+    }
+}
+
+std::string SoundbanksInfoBank(const std::string &xmlName)
+{
+    //the bank is the XML's sibling; streamed .wem files sit next to both
+    fs::path xmlPath(xmlName);
+    return (xmlPath.parent_path() / (xmlPath.filename().string().substr(0, xmlPath.filename().string().find('.')) + ".bnk")).generic_string();
+}
+
+bool ParseSoundbanksInfoFile(const std::string &xmlName, std::vector<Sound> &sounds)
+{
+    PERF_TIME(ParseXml);
+    tinyxml2::XMLDocument doc;
+    tinyxml2::XMLNode *xml = &doc;
+    doc.LoadFile(xmlName.c_str());
+    xml = xml->FirstChildElement("SoundBanksInfo");
+    if (!xml)
+    {
+        return false;
+    }
+    xml = xml->FirstChildElement("SoundBanks");
+    if (!xml)
+    {
+        return false;
+    }
+    xml = xml->FirstChildElement("SoundBank");
+    if (!xml)
+    {
+        return false;
+    }
+
+    std::vector<Sound> parsed;
+    if (xml->FirstChildElement("ReferencedStreamedFiles"))
+    {
+        ParseFiles(xml->FirstChildElement("ReferencedStreamedFiles"), true, parsed);
+    }
+    if (xml->FirstChildElement("IncludedMemoryFiles"))
+    {
+        ParseFiles(xml->FirstChildElement("IncludedMemoryFiles"), false, parsed);
+    }
+
+    std::string bankPath = SoundbanksInfoBank(xmlName);
+    for (auto &sound : parsed)
+    {
+        sound.bankPath = bankPath;
+    }
+    //stable, so a catalog loaded from the cache comes out in the same order
+    std::stable_sort(parsed.begin(), parsed.end(), [](const Sound &s1, const Sound &s2)
+    {
+        return s1.name < s2.name;
+    });
+    sounds.insert(sounds.end(), std::make_move_iterator(parsed.begin()), std::make_move_iterator(parsed.end()));
+    return true;
+}
+
+void DropMissingWems(std::vector<Sound> &sounds, size_t first, const WemSet *wems)
+{
+    sounds.erase(std::remove_if(sounds.begin() + first, sounds.end(), [wems](const Sound & s)
+    {
+        if (!s.streamed)
+        {
+            return false;
+        }
+        if (wems)
+        {
+            auto dir = wems->find(WemPath(s));
+            return dir == wems->end() || !dir->second.count(s.id);
+        }
+        std::error_code ec;
+        return !fs::exists(WemFileName(s), ec);
+    }
+    ), sounds.end());
+}
+
+bool ParseSoundbanksInfo(const std::string &xmlName, std::vector<Sound> &sounds)
+{
+    size_t first = sounds.size();
+    if (!ParseSoundbanksInfoFile(xmlName, sounds))
+    {
+        return false;
+    }
+    DropMissingWems(sounds, first);
+    return true;
+}
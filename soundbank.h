@@ -0,0 +1,277 @@
+#ifndef _SOUNDBANK_H
+#define _SOUNDBANK_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <stdint.h>
+#ifdef QT_CORE_LIB
+    #include <QDataStream>
+#endif
+
+
+typedef uint8_t UInt8;
+typedef uint16_t UInt16;
+typedef uint32_t UInt32;
+typedef UInt32 MediaID;
+typedef UInt32 Fourcc;
+constexpr UInt32 BankHeaderChunkID = 'DHKB';
+constexpr UInt32 BankDataIndexChunkID = 'XDID';
+constexpr UInt32 BankDataChunkID = 'ATAD';
+constexpr Fourcc RIFFChunkId = 'FFIR';
+constexpr Fourcc WAVEChunkId = 'EVAW';
+constexpr Fourcc fmtChunkId = ' tmf';
+constexpr Fourcc dataChunkId = 'atad';
+
+
+
+struct Sound
+{
+    std::string id;
+    std::string name;
+    std::string relativePath;
+    std::string bankPath;
+    bool streamed;
+};
+
+
+#pragma pack(push,1)
+struct SubchunkHeader
+{
+    UInt32 dwTag;
+    UInt32 dwChunkSize;
+};
+
+struct BankHeader
+{
+    UInt32 dwBankGeneratorVersion;
+    UInt32 dwSoundBankID;
+    UInt32 dwLanguageID;
+    UInt16 bFeedbackInBank;
+    UInt16 bDeviceAllocated;
+    UInt32 dwProjectID;
+};
+
+struct MediaHeader
+{
+    MediaID id;
+    UInt32 uOffset;
+    UInt32 uSize;
+};
+
+struct ChunkHeader
+{
+    Fourcc ChunkId;
+    UInt32 dwChunkSize;
+#ifdef QT_CORE_LIB
+    friend inline QDataStream &operator>>(QDataStream& in,ChunkHeader& item) {
+        in >> item.ChunkId;
+        in >> item.dwChunkSize;
+        return in;
+    }
+    friend inline QDataStream &operator<<(QDataStream& out, ChunkHeader& item) {
+        out << item.ChunkId;
+        out << item.dwChunkSize;
+        return out;
+    }
+#endif
+};
+struct WaveFormatEx
+{
+    UInt16 wFormatTag;
+    UInt16 nChannels;
+    UInt32 nSamplesPerSec;
+    UInt32 nAvgBytesPerSec;
+    UInt16 nBlockAlign;
+    UInt16 wBitsPerSample;
+    UInt16 cbSize;
+
+#ifdef QT_CORE_LIB
+    friend inline QDataStream &operator>>(QDataStream& in,WaveFormatEx& item) {
+        in >> item.wFormatTag;
+        in >> item.nChannels;
+        in >> item.nSamplesPerSec;
+        in >> item.nAvgBytesPerSec;
+        in >> item.nBlockAlign;
+        in >> item.wBitsPerSample;
+        in >> item.cbSize;
+        return in;
+
+    }
+    friend inline QDataStream &operator<<(QDataStream& out,WaveFormatEx& item) {
+        out << item.wFormatTag;
+        out << item.nChannels;
+        out << item.nSamplesPerSec;
+        out << item.nAvgBytesPerSec;
+        out << item.nBlockAlign;
+        out << item.wBitsPerSample;
+        out << item.cbSize;
+        return out;
+
+    }
+#endif
+};
+
+struct WaveFormatExtensible : public WaveFormatEx
+{
+    UInt16 wSamplesPerBlock;
+    UInt32 dwChannelMask;
+
+#ifdef QT_CORE_LIB
+    friend inline QDataStream &operator>>(QDataStream& in,WaveFormatExtensible& item) {
+        in >> (WaveFormatEx &)item;
+        in >> item.wSamplesPerBlock;
+        in >> item.dwChannelMask;
+        return in;
+    }
+    friend inline QDataStream &operator<<(QDataStream& out,WaveFormatExtensible& item) {
+        out << (WaveFormatEx &)item;
+        out << item.wSamplesPerBlock;
+        out << item.dwChannelMask;
+        return out;
+    }
+#endif
+};
+
+struct VorbisHeaderBase
+{
+    UInt32 dwTotalPCMFrames;
+};
+
+struct VorbisLoopInfo
+{
+    UInt32 dwLoopStartPacketOffset;
+    UInt32 dwLoopEndPacketOffset;
+    UInt16 uLoopBeginExtra;
+    UInt16 uLoopEndExtra;
+};
+
+struct VorbisInfo
+{
+    VorbisLoopInfo LoopInfo;
+    UInt32 dwSeekTableSize;
+    UInt32 dwVorbisDataOffset;
+    UInt16 uMaxPacketSize;
+    UInt16 uLastGranuleExtra;
+    UInt32 dwDecodeAllocSize;
+    UInt32 dwDecodeX64AllocSize;
+    UInt32 uHashCodebook;
+    UInt8 uBlockSizes[2];
+};
+struct VorbisHeader : public VorbisHeaderBase, public VorbisInfo
+{
+};
+#pragma pack(pop)
+
+
+//how the DATA chunk is about to be read, passed on to madvise
+enum class BankAccess
+{
+    Sequential,     //media extracted in offset order
+    Random          //any other order, e.g. sorted by name
+};
+
+//a mapped .bnk: its DIDX media table and a read-only view of the DATA chunk
+//the table points into. Media pointers into data stay valid until the bank
+//is unloaded or loaded again.
+struct SoundBank
+{
+    std::string path;
+    std::vector<MediaHeader> media;
+    const char *data = nullptr;
+    size_t dataSize = 0;
+
+    SoundBank() = default;
+    ~SoundBank();
+    SoundBank(const SoundBank &) = delete;
+    SoundBank &operator=(const SoundBank &) = delete;
+
+private:
+    friend bool LoadBank(const std::string &fname, SoundBank &bank);
+    friend void UnloadBank(SoundBank &bank);
+    friend void AdviseBank(const SoundBank &bank, BankAccess access);
+    void *mapping = nullptr;
+    size_t mappingSize = 0;
+};
+
+//map a whole file read-only; nullptr on failure or for an empty file
+void *MapFile(const std::string &fname, size_t &size);
+void UnmapFile(void *view, size_t size);
+
+bool LoadBank(const std::string &fname, SoundBank &bank);
+void UnloadBank(SoundBank &bank);
+void AdviseBank(const SoundBank &bank, BankAccess access);
+
+//MediaID -> (bank, offset, size) over the DIDX chunks of every added bank.
+//Banks stay mapped while the index lives, so lookups don't depend on any
+//"current" bank. Open addressing on the id; build it up front, after that
+//lookups are read-only and safe from any number of threads.
+class MediaIndex
+{
+public:
+    struct Location
+    {
+        MediaID id;
+        UInt32 bank;        //index into the added banks, InvalidBank for an empty slot
+        UInt32 uOffset;
+        UInt32 uSize;
+    };
+    static constexpr UInt32 InvalidBank = 0xFFFFFFFF;
+
+    MediaIndex() = default;
+    MediaIndex(const MediaIndex &) = delete;
+    MediaIndex &operator=(const MediaIndex &) = delete;
+
+    //map a bank and index its media; a path that was already added is skipped.
+    //An id already indexed from another bank keeps its first location.
+    bool AddBank(const std::string &fname);
+    const Location *Find(MediaID id) const;
+    //nullptr if the bank doesn't hold that media id
+    const char *FindMedia(MediaID id, UInt32 &size) const;
+    //nullptr if the bank was never added
+    const SoundBank *FindBank(const std::string &fname) const;
+    //a reference that keeps the bank mapped even past the index's lifetime
+    std::shared_ptr<const SoundBank> ShareBank(const std::string &fname) const;
+    //the bank the location's media is in, which needn't be the bank a sound names
+    std::shared_ptr<const SoundBank> ShareBank(const Location &location) const { return banks[location.bank]; }
+    size_t size() const { return count; }
+
+private:
+    void Insert(const Location &location);
+    void Grow();
+
+    std::vector<std::shared_ptr<SoundBank>> banks;
+    std::unordered_map<std::string, size_t> bankByPath;
+    std::vector<Location> table;
+    size_t count = 0;
+};
+
+//.wem files found by listing directories: directory, as WemPath gives it,
+//to the media ids (file name stems) in it
+typedef std::unordered_map<std::string, std::unordered_set<std::string>> WemSet;
+
+//a sound's id as a media id; false if it isn't a decimal 32 bit number
+bool ParseMediaID(const std::string &text, MediaID &id);
+
+//order sounds so in-memory media is read in DATA offset order
+void SortByBankOffset(const MediaIndex &index, std::vector<Sound> &sounds);
+
+//parse one SoundbanksInfo XML and append its sounds (bankPath filled in,
+//streamed sounds whose .wem is missing dropped). false if it isn't one.
+bool ParseSoundbanksInfo(const std::string &xmlName, std::vector<Sound> &sounds);
+//its two halves: every sound the XML lists, sorted by name, and the
+//filesystem check on sounds from first on
+bool ParseSoundbanksInfoFile(const std::string &xmlName, std::vector<Sound> &sounds);
+//wems, when given, lists every .wem on disk and replaces asking the filesystem per sound
+void DropMissingWems(std::vector<Sound> &sounds, size_t first = 0, const WemSet *wems = nullptr);
+//the .bnk a SoundbanksInfo XML describes
+std::string SoundbanksInfoBank(const std::string &xmlName);
+
+//directory streamed .wem files of this sound's bank live in
+std::string WemPath(const Sound &sound);
+//the streamed sound's own .wem
+std::string WemFileName(const Sound &sound);
+
+#endif // _SOUNDBANK_H
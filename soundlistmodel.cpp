@@ -0,0 +1,110 @@
+/*
+soundextract
+Copyright 2018 Jonathan wilson
+Copyright 2020 Sławomir Śpiewak
+
+Soundextract is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version. See the file COPYING for more details.
+*/
+
+//list model over the sound catalog
+#include <algorithm>
+#include "soundlistmodel.h"
+
+SoundListModel::SoundListModel(SoundCatalog &catalog, QObject *parent)
+    : QAbstractListModel(parent)
+    , catalog(catalog)
+{
+}
+
+int SoundListModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return static_cast<int>(catalog.size());
+}
+
+QVariant SoundListModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= rowCount())
+        return QVariant();
+    SoundCatalog::Handle soundHandle = handle(index.row());
+    const Sound &sound = catalog[soundHandle];
+    switch (role)
+    {
+    case Qt::DisplayRole:
+        return QString::fromStdString(sound.name);
+    case Qt::ToolTipRole:
+        return QString::fromStdString(sound.streamed ? WemFileName(sound) : sound.bankPath);
+    case HandleRole:
+        return soundHandle;
+    default:
+        return QVariant();
+    }
+}
+
+void SoundListModel::addSounds(std::vector<Sound> &&sounds)
+{
+    if (sounds.empty())
+        return;
+    //rows only get appended if the new names all sort after the last one listed
+    bool append = catalog.empty();
+    if (!append)
+    {
+        const std::string &last = catalog[catalog.ByName().back()].name;
+        append = std::all_of(sounds.begin(), sounds.end(), [&last](const Sound &sound)
+        {
+            return sound.name >= last;
+        });
+    }
+    if (append)
+    {
+        int first = rowCount();
+        beginInsertRows(QModelIndex(), first, first + static_cast<int>(sounds.size()) - 1);
+        catalog.Add(std::move(sounds));
+        endInsertRows();
+    }
+    else
+    {
+        beginResetModel();
+        catalog.Add(std::move(sounds));
+        endResetModel();
+    }
+}
+
+std::vector<SoundCatalog::Handle> SoundListModel::handles(const QItemSelection &selection) const
+{
+    std::vector<SoundCatalog::Handle> selected;
+    for (const QItemSelectionRange &range : selection)
+    {
+        for (int row = range.top(); row <= range.bottom(); row++)
+            selected.push_back(handle(row));
+    }
+    return selected;
+}
+
+QItemSelection SoundListModel::selection(const std::vector<SoundCatalog::Handle> &handles) const
+{
+    QItemSelection rows;
+    if (handles.empty())
+        return rows;
+    std::vector<int> rowOf(catalog.size());
+    for (int row = 0; row < rowCount(); row++)
+        rowOf[handle(row)] = row;
+    std::vector<int> selected;
+    selected.reserve(handles.size());
+    for (SoundCatalog::Handle soundHandle : handles)
+        selected.push_back(rowOf[soundHandle]);
+    std::sort(selected.begin(), selected.end());
+    for (size_t i = 0; i < selected.size();)
+    {
+        size_t end = i + 1;
+        while (end < selected.size() && selected[end] <= selected[end - 1] + 1)
+            end++;
+        rows.append(QItemSelectionRange(index(selected[i]), index(selected[end - 1])));
+        i = end;
+    }
+    return rows;
+}
@@ -0,0 +1,39 @@
+#ifndef _SOUNDLISTMODEL_H
+#define _SOUNDLISTMODEL_H
+
+#include <QAbstractListModel>
+#include <QItemSelection>
+#include <vector>
+#include "catalog.h"
+
+//list model straight over a SoundCatalog, one row per sound in name order.
+//Nothing is stored per row; names and tooltips become QStrings only when a
+//view asks for a visible row.
+class SoundListModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    //the catalog handle of a row, as a uint
+    static constexpr int HandleRole = Qt::UserRole;
+
+    explicit SoundListModel(SoundCatalog &catalog, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    //add sounds to the catalog. Sounds sorting after everything already
+    //listed are inserted as rows, anything else resets the model.
+    void addSounds(std::vector<Sound> &&sounds);
+
+    SoundCatalog::Handle handle(int row) const { return catalog.ByName()[row]; }
+    //the rows of a selection of this model's indexes, as handles
+    std::vector<SoundCatalog::Handle> handles(const QItemSelection &selection) const;
+    //the rows holding these handles, merged into ranges
+    QItemSelection selection(const std::vector<SoundCatalog::Handle> &handles) const;
+
+private:
+    SoundCatalog &catalog;
+};
+
+#endif // _SOUNDLISTMODEL_H
@@ -0,0 +1,292 @@
+/*
+soundextract
+Copyright 2018 Jonathan wilson
+Copyright 2020 Sławomir Śpiewak
+
+Soundextract is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version. See the file COPYING for more details.
+*/
+
+//Wwise Vorbis to PCM through libvorbis
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <ogg/ogg.h>
+#include <vorbis/codec.h>
+#include "vorbisdecode.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define PCM_SSE2
+    #include <emmintrin.h>
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+    #define PCM_NEON
+    #include <arm_neon.h>
+#endif
+
+namespace
+{
+
+//WAV channel i is Vorbis channel order[channels][i]
+const int channelOrder[9][8] = {
+    { },
+    { 0 },
+    { 0, 1 },
+    { 0, 2, 1 },
+    { 0, 1, 2, 3 },
+    { 0, 2, 1, 3, 4 },
+    { 0, 2, 1, 5, 3, 4 },
+    { 0, 2, 1, 6, 5, 3, 4 },
+    { 0, 2, 1, 7, 5, 6, 3, 4 },
+};
+
+//libvorbis decoder state for one worker thread
+struct Decoder
+{
+    std::string headers;    //identification and setup packets the state was built from
+    vorbis_info info;
+    vorbis_comment comment;
+    vorbis_dsp_state dsp;
+    vorbis_block block;
+    bool ready = false;
+
+    ~Decoder()
+    {
+        Reset();
+    }
+
+    void Reset()
+    {
+        if (ready)
+        {
+            vorbis_block_clear(&block);
+            vorbis_dsp_clear(&dsp);
+            vorbis_comment_clear(&comment);
+            vorbis_info_clear(&info);
+            ready = false;
+        }
+        headers.clear();
+    }
+
+    static Decoder &ForThisThread()
+    {
+        thread_local Decoder decoder;
+        return decoder;
+    }
+};
+
+//scale, clamp and round to nearest even like ov_read does on x86-64
+inline int16_t ToInt16(float sample)
+{
+    sample *= 32768.f;
+    if (!(sample >= -32768.f))
+        sample = -32768.f;
+    if (sample > 32767.f)
+        sample = 32767.f;
+    return static_cast<int16_t>(lrintf(sample));
+}
+
+void Interleave(float *const *pcm, const int *order, unsigned int channels, size_t samples, int16_t *out)
+{
+    size_t i = 0;
+#if defined(PCM_SSE2)
+    const __m128 scale = _mm_set1_ps(32768.f), low = _mm_set1_ps(-32768.f), high = _mm_set1_ps(32767.f);
+    //max before min so NaN ends up at the bottom, as in ToInt16
+    auto convert = [&](const float *p)
+    {
+        return _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(p), scale), low), high));
+    };
+    if (channels == 1)
+    {
+        for (; i + 8 <= samples; i += 8)
+        {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_packs_epi32(convert(pcm[0] + i), convert(pcm[0] + i + 4)));
+        }
+    }
+    else if (channels == 2)
+    {
+        const float *left = pcm[order[0]], *right = pcm[order[1]];
+        for (; i + 4 <= samples; i += 4)
+        {
+            __m128i l = convert(left + i), r = convert(right + i);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 2 * i), _mm_packs_epi32(_mm_unpacklo_epi32(l, r), _mm_unpackhi_epi32(l, r)));
+        }
+    }
+    else
+    {
+        alignas(16) int16_t converted[8];
+        for (; i + 8 <= samples; i += 8)
+        {
+            for (unsigned int c = 0; c < channels; c++)
+            {
+                const float *p = pcm[order[c]] + i;
+                _mm_store_si128(reinterpret_cast<__m128i *>(converted), _mm_packs_epi32(convert(p), convert(p + 4)));
+                for (unsigned int k = 0; k < 8; k++)
+                {
+                    out[(i + k) * channels + c] = converted[k];
+                }
+            }
+        }
+    }
+#elif defined(PCM_NEON)
+    const float32x4_t scale = vdupq_n_f32(32768.f), low = vdupq_n_f32(-32768.f), high = vdupq_n_f32(32767.f);
+    auto convert = [&](const float *p)
+    {
+        return vqmovn_s32(vcvtnq_s32_f32(vminq_f32(vmaxq_f32(vmulq_f32(vld1q_f32(p), scale), low), high)));
+    };
+    if (channels == 1)
+    {
+        for (; i + 4 <= samples; i += 4)
+        {
+            vst1_s16(out + i, convert(pcm[0] + i));
+        }
+    }
+    else if (channels == 2)
+    {
+        const float *left = pcm[order[0]], *right = pcm[order[1]];
+        for (; i + 4 <= samples; i += 4)
+        {
+            int16x4x2_t frames = { { convert(left + i), convert(right + i) } };
+            vst2_s16(out + 2 * i, frames);
+        }
+    }
+#endif
+    for (; i < samples; i++)
+    {
+        for (unsigned int c = 0; c < channels; c++)
+        {
+            out[i * channels + c] = ToInt16(pcm[order[c]][i]);
+        }
+    }
+}
+
+//feeds the rebuilt packets to libvorbis and collects the PCM
+class PcmSink : public Ogg_packet_sink
+{
+public:
+    PcmSink(std::vector<char> &out) : out(out), decoder(Decoder::ForThisThread())
+    {
+    }
+
+    void packet(const unsigned char *data, unsigned int bytes, uint32_t granule, bool first, bool last) override
+    {
+        ogg_packet op;
+        op.packet = const_cast<unsigned char *>(data);
+        op.bytes = bytes;
+        op.b_o_s = first;
+        op.e_o_s = last;
+        op.granulepos = granule;
+        op.packetno = packetno++;
+        if (op.packetno < 3)
+        {
+            headerPackets[op.packetno].assign(reinterpret_cast<const char *>(data), bytes);
+            if (op.packetno == 2 && (started = Start()))
+            {
+                //more channels than WAV has an order for are kept in Vorbis order
+                order.resize(channels());
+                for (unsigned int c = 0; c < channels(); c++)
+                {
+                    order[c] = channels() <= 8 ? channelOrder[channels()][c] : static_cast<int>(c);
+                }
+            }
+            return;
+        }
+        if (!started)
+        {
+            return;
+        }
+        //like vorbisfile, a packet libvorbis can't use is skipped
+        if (vorbis_synthesis(&decoder.block, &op) == 0)
+        {
+            vorbis_synthesis_blockin(&decoder.dsp, &decoder.block);
+        }
+        float **pcm;
+        int samples;
+        while ((samples = vorbis_synthesis_pcmout(&decoder.dsp, &pcm)) > 0)
+        {
+            size_t offset = out.size();
+            out.resize(offset + static_cast<size_t>(samples) * channels() * sizeof(int16_t));
+            Interleave(pcm, order.data(), channels(), samples, reinterpret_cast<int16_t *>(out.data() + offset));
+            vorbis_synthesis_read(&decoder.dsp, samples);
+        }
+    }
+
+    bool Started() const
+    {
+        return started;
+    }
+
+    unsigned int channels() const
+    {
+        return static_cast<unsigned int>(decoder.info.channels);
+    }
+
+    unsigned int rate() const
+    {
+        return static_cast<unsigned int>(decoder.info.rate);
+    }
+
+private:
+    //reuse the thread's state when the previous sound had the same headers
+    bool Start()
+    {
+        std::string key = headerPackets[0] + headerPackets[2];
+        if (decoder.ready && decoder.headers == key)
+        {
+            return vorbis_synthesis_restart(&decoder.dsp) == 0;
+        }
+        decoder.Reset();
+        vorbis_info_init(&decoder.info);
+        vorbis_comment_init(&decoder.comment);
+        for (int i = 0; i < 3; i++)
+        {
+            ogg_packet op;
+            op.packet = reinterpret_cast<unsigned char *>(&headerPackets[i][0]);
+            op.bytes = static_cast<long>(headerPackets[i].size());
+            op.b_o_s = i == 0;
+            op.e_o_s = 0;
+            op.granulepos = 0;
+            op.packetno = i;
+            if (vorbis_synthesis_headerin(&decoder.info, &decoder.comment, &op) != 0)
+            {
+                vorbis_comment_clear(&decoder.comment);
+                vorbis_info_clear(&decoder.info);
+                return false;
+            }
+        }
+        if (vorbis_synthesis_init(&decoder.dsp, &decoder.info) != 0)
+        {
+            vorbis_comment_clear(&decoder.comment);
+            vorbis_info_clear(&decoder.info);
+            return false;
+        }
+        vorbis_block_init(&decoder.dsp, &decoder.block);
+        decoder.ready = true;
+        decoder.headers.swap(key);
+        return true;
+    }
+
+    std::vector<char> &out;
+    Decoder &decoder;
+    std::string headerPackets[3];
+    std::vector<int> order;
+    long packetno = 0;
+    bool started = false;
+};
+
+}
+
+bool DecodeVorbis(Wwise_RIFF_Vorbis &ww, std::vector<char> &out, unsigned int &channels, unsigned int &rate)
+{
+    PcmSink sink(out);
+    ww.generate_packets(sink);
+    if (!sink.Started())
+    {
+        return false;
+    }
+    channels = sink.channels();
+    rate = sink.rate();
+    return true;
+}
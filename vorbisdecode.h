@@ -0,0 +1,14 @@
+#ifndef _VORBISDECODE_H
+#define _VORBISDECODE_H
+
+#include <vector>
+#include "wwriff.h"
+
+//decodes the Vorbis stream ww rebuilds straight to interleaved 16 bit PCM
+//with libvorbis, no Ogg pages in between. Samples are appended to out in
+//WAV channel order. Each thread keeps its libvorbis state and reuses it for
+//the next sound with the same headers. Throws what ww throws; false if
+//libvorbis rejects the headers.
+bool DecodeVorbis(Wwise_RIFF_Vorbis &ww, std::vector<char> &out, unsigned int &channels, unsigned int &rate);
+
+#endif // _VORBISDECODE_H
@@ -6,10 +6,56 @@
 #include "wwriff.h"
 #include "Bit_stream.h"
 #include "codebook.h"
+#include "perf.h"
 #include <sstream>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
 
 using namespace std;
 
+namespace {
+// A game's wems share a handful of setup packets; the translated packet and
+// its mode table are kept for the life of the process and shared by every
+// converter, on any thread.
+struct Setup_cache_entry
+{
+    vector<unsigned char> packet;
+    vector<bool> mode_blockflag;    // empty when the setup was copied as is
+    int mode_bits;
+};
+
+class Setup_cache
+{
+    shared_mutex _mutex;
+    unordered_map<string, shared_ptr<const Setup_cache_entry>> _entries;
+
+public:
+    enum { max_entries = 1024 };
+
+    shared_ptr<const Setup_cache_entry> find(const string& key)
+    {
+        shared_lock<shared_mutex> lock(_mutex);
+        auto it = _entries.find(key);
+        return it == _entries.end() ? nullptr : it->second;
+    }
+
+    void insert(const string& key, shared_ptr<const Setup_cache_entry> entry)
+    {
+        unique_lock<shared_mutex> lock(_mutex);
+        if (_entries.size() < max_entries)
+            _entries.emplace(key, std::move(entry));
+    }
+
+    static Setup_cache& instance(void)
+    {
+        static Setup_cache cache;
+        return cache;
+    }
+};
+}
+
 /* Modern 2 or 6 byte header */
 class Packet
 {
@@ -18,7 +64,7 @@ class Packet
     uint32_t _absolute_granule;
     bool _no_granule;
 public:
-    Packet(ifstream& i, long o, bool little_endian, bool no_granule = false) : _offset(o), _size(0xFFFF), _absolute_granule(0), _no_granule(no_granule) {
+    Packet(istream& i, long o, bool little_endian, bool no_granule = false) : _offset(o), _size(0xFFFF), _absolute_granule(0), _no_granule(no_granule) {
         i.seekg(_offset);
 
         if (little_endian)
@@ -53,7 +99,7 @@ class Packet_8
     uint32_t _size;
     uint32_t _absolute_granule;
 public:
-    Packet_8(ifstream& i, long o, bool little_endian) : _offset(o), _size(0xFFFFFFFF), _absolute_granule(0) {
+    Packet_8(istream& i, long o, bool little_endian) : _offset(o), _size(0xFFFFFFFF), _absolute_granule(0) {
         i.seekg(_offset);
 
         if (little_endian)
@@ -100,13 +146,51 @@ public:
 
 const char Vorbis_packet_header::vorbis_str[6] = {'v','o','r','b','i','s'};
 
+namespace {
+    vector<char> read_file(const string& name)
+    {
+        ifstream in(name.c_str(), ios::binary);
+        if (!in) throw File_open_error(name);
+
+        in.seekg(0, ios::end);
+        vector<char> data(static_cast<size_t>(in.tellg()));
+        in.seekg(0, ios::beg);
+        in.read(data.data(), data.size());
+        if (!in) throw File_open_error(name);
+
+        return data;
+    }
+}
+
+Wwise_RIFF_Vorbis::Wwise_RIFF_Vorbis(
+    const string& name
+    )
+  : Wwise_RIFF_Vorbis(name, read_file(name), nullptr, 0)
+{
+}
+
 Wwise_RIFF_Vorbis::Wwise_RIFF_Vorbis(
+    const char * data,
+    long size,
     const string& name
     )
+  : Wwise_RIFF_Vorbis(name, vector<char>(), data, size)
+{
+}
+
+Wwise_RIFF_Vorbis::Wwise_RIFF_Vorbis(
+    const string& name,
+    vector<char>&& file_data,
+    const char * data,
+    long size
+    )
   :
     _file_name(name),
-    _infile(name.c_str(), ios::binary),
-    _file_size(-1),
+    _file_data(std::move(file_data)),
+    _data(data ? data : _file_data.data()),
+    _file_size(data ? size : static_cast<long>(_file_data.size())),
+    _span(_data, _file_size),
+    _infile(&_span),
     _little_endian(true),
     _riff_size(-1),
     _fmt_offset(-1),
@@ -145,11 +229,7 @@ Wwise_RIFF_Vorbis::Wwise_RIFF_Vorbis(
     _read_16(nullptr),
     _read_32(nullptr)
 {
-    if (!_infile) throw File_open_error(name);
-
-    _infile.seekg(0, ios::end);
-    _file_size = static_cast<long>(_infile.tellg());
-
+    if (!_data) throw File_open_error(name);
 
     // check RIFF header
     {
@@ -442,6 +522,7 @@ Wwise_RIFF_Vorbis::Wwise_RIFF_Vorbis(
 
 void Wwise_RIFF_Vorbis::generate_ogg_header(Bit_oggstream& os, bool * & mode_blockflag, int & mode_bits)
 {
+    PERF_TIME(Setup);
     // generate identification packet
     {
         Vorbis_packet_header vhead(1);
@@ -536,6 +617,19 @@ void Wwise_RIFF_Vorbis::generate_ogg_header(Bit_oggstream& os, bool * & mode_blo
         os.flush_page();
     }
 
+    string cache_key;
+    {
+        Packet setup_packet(_infile, _data_offset + _setup_packet_offset, _little_endian, _no_granule);
+        cache_key = setup_cache_key(setup_packet.offset(), setup_packet.size());
+        if (setup_packet.granule() == 0 && setup_packet.next_offset() == _data_offset + static_cast<long>(_first_audio_packet_offset) &&
+            put_cached_setup(os, cache_key, mode_blockflag, mode_bits))
+        {
+            PERF_COUNT(SetupCacheHits, 1);
+            return;
+        }
+        PERF_COUNT(SetupCacheMisses, 1);
+    }
+
     // generate setup packet
     {
         Vorbis_packet_header vhead(5);
@@ -544,9 +638,8 @@ void Wwise_RIFF_Vorbis::generate_ogg_header(Bit_oggstream& os, bool * & mode_blo
 
         Packet setup_packet(_infile, _data_offset + _setup_packet_offset, _little_endian, _no_granule);
 
-        _infile.seekg(setup_packet.offset());
         if (setup_packet.granule() != 0) throw Parse_error_str("setup packet granule != 0");
-        Bit_stream ss(_infile);
+        Bit_stream ss = bits_at(setup_packet.offset());
 
         // codebook count
         Bit_uint<8> codebook_count_less1;
@@ -566,10 +659,12 @@ void Wwise_RIFF_Vorbis::generate_ogg_header(Bit_oggstream& os, bool * & mode_blo
                 if (_full_setup)
                 {
                     cbl.copy(ss, os);
+                    PERF_COUNT(CodebooksCopied, 1);
                 }
                 else
                 {
                     cbl.rebuild(ss, 0, os);
+                    PERF_COUNT(CodebooksRebuilt, 1);
                 }
             }
         }
@@ -587,6 +682,7 @@ void Wwise_RIFF_Vorbis::generate_ogg_header(Bit_oggstream& os, bool * & mode_blo
                 try
                 {
                     cbl.rebuild(codebook_id, os);
+                    PERF_COUNT(CodebooksRebuilt, 1);
                 }
                 catch (Invalid_id e)
                 {
@@ -888,8 +984,9 @@ void Wwise_RIFF_Vorbis::generate_ogg_header(Bit_oggstream& os, bool * & mode_blo
             unsigned int mode_count = mode_count_less1 + 1;
             os << mode_count_less1;
 
-            mode_blockflag = new bool [mode_count];
             mode_bits = ilog(mode_count-1);
+            // sized for every encodable mode number, unused ones read as short
+            mode_blockflag = new bool [1U << mode_bits]();
 
             //cout << mode_count << " modes" << endl;
 
@@ -916,19 +1013,81 @@ void Wwise_RIFF_Vorbis::generate_ogg_header(Bit_oggstream& os, bool * & mode_blo
 
         } // _full_setup
 
+        shared_ptr<Setup_cache_entry> entry = make_shared<Setup_cache_entry>();
+        {
+            unsigned int bytes;
+            const unsigned char * payload = os.get_payload(bytes);
+            // a setup packet spanning pages isn't cached
+            if (!payload)
+                cache_key.clear();
+            entry->packet.assign(payload, payload + bytes);
+            entry->mode_bits = mode_bits;
+            if (mode_blockflag)
+                entry->mode_blockflag.assign(mode_blockflag, mode_blockflag + (1U << mode_bits));
+        }
+
         os.flush_page();
 
         if ((ss.get_total_bits_read()+7)/8 != setup_packet.size()) throw Parse_error_str("didn't read exactly setup packet");
 
         if (setup_packet.next_offset() != _data_offset + static_cast<long>(_first_audio_packet_offset)) throw Parse_error_str("first audio packet doesn't follow setup packet");
 
+        if (!cache_key.empty())
+            Setup_cache::instance().insert(cache_key, std::move(entry));
+    }
+}
+
+string Wwise_RIFF_Vorbis::setup_cache_key(long offset, long size) const
+{
+    if (offset < 0 || size < 0 || offset > _file_size || size > _file_size - offset) return string();
+
+    // channel count and blocksizes, plus the options that change the output
+    unsigned char params[] = {
+        static_cast<unsigned char>(_channels & 0xFF), static_cast<unsigned char>(_channels >> 8),
+        _blocksize_0_pow, _blocksize_1_pow,
+        static_cast<unsigned char>((_inline_codebooks ? 1 : 0) | (_full_setup ? 2 : 0))
+    };
+    string key;
+    key.reserve(sizeof(params) + size);
+    key.append(reinterpret_cast<const char *>(params), sizeof(params));
+    key.append(_data + offset, size);
+    return key;
+}
+
+bool Wwise_RIFF_Vorbis::put_cached_setup(Bit_oggstream& os, const string& key, bool * & mode_blockflag, int & mode_bits)
+{
+    if (key.empty()) return false;
+
+    shared_ptr<const Setup_cache_entry> entry = Setup_cache::instance().find(key);
+    if (!entry) return false;
+
+    os.put_bytes(entry->packet.data(), entry->packet.size());
+    os.flush_page();
+
+    mode_bits = entry->mode_bits;
+    if (!entry->mode_blockflag.empty())
+    {
+        mode_blockflag = new bool [entry->mode_blockflag.size()];
+        for (size_t i = 0; i < entry->mode_blockflag.size(); i++)
+            mode_blockflag[i] = entry->mode_blockflag[i];
     }
+    return true;
 }
 
-void Wwise_RIFF_Vorbis::generate_ogg(ofstream& of)
+void Wwise_RIFF_Vorbis::generate_ogg(ostream& of)
 {
     Bit_oggstream os(of);
+    generate(os);
+}
+
+void Wwise_RIFF_Vorbis::generate_packets(Ogg_packet_sink& sink)
+{
+    Bit_oggstream os(sink);
+    generate(os);
+}
 
+void Wwise_RIFF_Vorbis::generate(Bit_oggstream& os)
+{
     bool * mode_blockflag = nullptr;
     int mode_bits = 0;
     bool prev_blockflag = false;
@@ -942,8 +1101,17 @@ void Wwise_RIFF_Vorbis::generate_ogg(ofstream& of)
         generate_ogg_header(os, mode_blockflag, mode_bits);
     }
 
+    // granule positions are only computed here when the mode table was
+    // rebuilt; a copied header triad still needs a revorb pass
+    const bool compute_granule = (mode_blockflag != nullptr);
+    const unsigned int blocksize_0 = 1U << _blocksize_0_pow;
+    const unsigned int blocksize_1 = 1U << _blocksize_1_pow;
+    unsigned int prev_blocksize = 0;
+    uint32_t granpos = 0;
+
     // Audio pages
     {
+        PERF_TIME(AudioPackets);
         long offset = _data_offset + _first_audio_packet_offset;
 
         while (offset < _data_offset + _data_size)
@@ -976,17 +1144,27 @@ void Wwise_RIFF_Vorbis::generate_ogg(ofstream& of)
 
             offset = packet_payload_offset;
 
-            _infile.seekg(offset);
-            // HACK: don't know what to do here
-            if (granule == UINT32_C(0xFFFFFFFF))
+            // the first byte is read even for an empty packet
+            if (offset >= _file_size || size > _file_size - offset)
             {
-                os.set_granule(1);
+                throw Parse_error_str("file truncated");
             }
-            else
+
+            if (!compute_granule)
             {
-                os.set_granule(granule);
+                // HACK: don't know what to do here
+                if (granule == UINT32_C(0xFFFFFFFF))
+                {
+                    os.set_granule(1);
+                }
+                else
+                {
+                    os.set_granule(granule);
+                }
             }
 
+            bool blockflag = false;
+
             // first byte
             if (_mod_packets)
             {
@@ -1007,7 +1185,7 @@ void Wwise_RIFF_Vorbis::generate_ogg(ofstream& of)
                 {
                     // collect mode number from first byte
 
-                    Bit_stream ss(_infile);
+                    Bit_stream ss = bits_at(offset);
 
                     // IN/OUT: N bit mode number (max 6 bits)
                     mode_number_p = new Bit_uintv(mode_bits);
@@ -1033,9 +1211,7 @@ void Wwise_RIFF_Vorbis::generate_ogg(ofstream& of)
                         uint32_t next_packet_size = audio_packet.size();
                         if (next_packet_size > 0)
                         {
-                            _infile.seekg(audio_packet.offset());
-
-                            Bit_stream ss(_infile);
+                            Bit_stream ss = bits_at(audio_packet.offset());
                             Bit_uintv next_mode_number(mode_bits);
 
                             ss >> next_mode_number;
@@ -1051,12 +1227,10 @@ void Wwise_RIFF_Vorbis::generate_ogg(ofstream& of)
                     // OUT: next window type bit
                     Bit_uint<1> next_window_type(next_blockflag);
                     os << next_window_type;
-
-                    // fix seek for rest of stream
-                    _infile.seekg(offset + 1);
                 }
 
                 prev_blockflag = mode_blockflag[*mode_number_p];
+                blockflag = prev_blockflag;
                 delete mode_number_p;
 
                 // OUT: remaining bits of first (input) byte
@@ -1065,30 +1239,40 @@ void Wwise_RIFF_Vorbis::generate_ogg(ofstream& of)
             }
             else
             {
-                // nothing unusual for first byte
-                int v = _infile.get();
-                if (v < 0)
+                // nothing unusual for first byte, it goes out with the rest
+                unsigned char v = static_cast<unsigned char>(_data[offset]);
+
+                // 1 bit packet type, then the mode number
+                if (compute_granule)
                 {
-                    throw Parse_error_str("file truncated");
+                    blockflag = mode_blockflag[(v >> 1) & ((1 << mode_bits) - 1)];
                 }
-                Bit_uint<8> c(v);
-                os << c;
             }
 
-            // remainder of packet
-            for (unsigned int i = 1; i < size; i++)
+            // same accumulation revorb does: each packet completes
+            // (previous + current) / 4 samples
+            if (compute_granule && size != 0)
             {
-                int v = _infile.get();
-                if (v < 0)
+                unsigned int blocksize = blockflag ? blocksize_1 : blocksize_0;
+                if (prev_blocksize)
                 {
-                    throw Parse_error_str("file truncated");
+                    granpos += (prev_blocksize + blocksize) / 4;
                 }
-                Bit_uint<8> c(v);
-                os << c;
+                prev_blocksize = blocksize;
+                os.set_granule(granpos);
+            }
+
+            // remainder of packet; without mod packets the whole payload
+            // is byte-aligned and goes into the page in one copy
+            {
+                long copy_from = _mod_packets ? offset + 1 : offset;
+                long copy_end = offset + (size ? size : 1);
+                os.put_bytes(reinterpret_cast<const unsigned char *>(_data) + copy_from, copy_end - copy_from);
             }
 
             offset = next_offset;
             os.flush_page( false, (offset == _data_offset + _data_size) );
+            PERF_COUNT(Packets, 1);
         }
         if (offset > _data_offset + _data_size) throw Parse_error_str("page truncated");
     }
@@ -1098,6 +1282,7 @@ void Wwise_RIFF_Vorbis::generate_ogg(ofstream& of)
 
 void Wwise_RIFF_Vorbis::generate_ogg_header_with_triad(Bit_oggstream& os)
 {
+    PERF_TIME(Setup);
     // Header page triad
     {
         long offset = _data_offset + _setup_packet_offset;
@@ -1170,9 +1355,8 @@ void Wwise_RIFF_Vorbis::generate_ogg_header_with_triad(Bit_oggstream& os)
         {
             Packet_8 setup_packet(_infile, offset, _little_endian);
 
-            _infile.seekg(setup_packet.offset());
             if (setup_packet.granule() != 0) throw Parse_error_str("setup packet granule != 0");
-            Bit_stream ss(_infile);
+            Bit_stream ss = bits_at(setup_packet.offset());
 
             Bit_uint<8> c;
             ss >> c;
@@ -1204,6 +1388,7 @@ void Wwise_RIFF_Vorbis::generate_ogg_header_with_triad(Bit_oggstream& os)
             {
                 cbl.copy(ss, os);
             }
+            PERF_COUNT(CodebooksCopied, codebook_count);
 
             while (ss.get_total_bits_read() < setup_packet.size()*8u)
             {
@@ -6,6 +6,7 @@
 #endif
 #include <string>
 #include <fstream>
+#include <vector>
 #include "Bit_stream.h"
 #include "stdint.h"
 
@@ -23,8 +24,11 @@ enum ForcePacketFormat {
 class Wwise_RIFF_Vorbis
 {
     string _file_name;
-    ifstream _infile;
+    vector<char> _file_data;    // only filled when reading from a file
+    const char * _data;
     long _file_size;
+    span_streambuf _span;
+    istream _infile;
 
     bool _little_endian;
 
@@ -61,12 +65,47 @@ class Wwise_RIFF_Vorbis
 
     uint16_t (*_read_16)(std::istream &is);
     uint32_t (*_read_32)(std::istream &is);
-public:
     Wwise_RIFF_Vorbis(
+      const string& name,
+      vector<char>&& file_data,
+      const char * data,
+      long size
+      );
+
+    // word-at-a-time bit reader over the file data from offset on
+    Bit_stream bits_at(long offset) const
+    {
+        if (offset < 0 || offset > _file_size) throw Parse_error_str("bit read past end of file");
+        return Bit_stream(reinterpret_cast<const unsigned char *>(_data) + offset, static_cast<size_t>(_file_size - offset));
+    }
+
+    // setup packet bytes plus everything else its translation depends on;
+    // empty if the packet isn't inside the file
+    string setup_cache_key(long offset, long size) const;
+    // emit an already translated setup packet; false if it isn't cached
+    bool put_cached_setup(Bit_oggstream& os, const string& key, bool * & mode_blockflag, int & mode_bits);
+
+    void generate(Bit_oggstream& os);
+public:
+    explicit Wwise_RIFF_Vorbis(
       const string& name
       );
 
-    void generate_ogg(ofstream& of);
+    // convert straight from a wem held in memory (a bank DATA slice or a
+    // streamed .wem buffer); the span must outlive this object
+    Wwise_RIFF_Vorbis(
+      const char * data,
+      long size,
+      const string& name = "memory"
+      );
+
+    // generate_ogg computes granule positions itself except when the
+    // header triad is copied verbatim; those files still need revorb()
+    bool needs_revorb(void) const { return _header_triad_present; }
+
+    void generate_ogg(ostream& of);
+    // the same packets, handed to sink one by one rather than paged
+    void generate_packets(Ogg_packet_sink& sink);
     void generate_ogg_header(Bit_oggstream& os, bool * & mode_blockflag, int & mode_bits);
     void generate_ogg_header_with_triad(Bit_oggstream& os);
 };